@@ -0,0 +1,119 @@
+#pragma once
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// CPU pinning and NUMA placement for the server's threads, without libnuma.
+//
+// A thread pinned to CPUs of a single node also prefers that node for the
+// pages it touches first. Whatever an I/O thread allocates for its
+// connections (the connection itself, rx streambufs, tx queues) then lives
+// next to the cores that use it, as long as it is allocated there - which is
+// why connections are constructed on their I/O thread, not the acceptor's.
+//
+// On a single-node machine this reduces to pinning.
+namespace affinity {
+    using cpus = std::vector<int>;
+
+    // "0-3,8,10-11"
+    inline cpus parse(std::string const& list) {
+        cpus r;
+        for (size_t pos = 0; pos < list.size();) {
+            auto end  = list.find(',', pos);
+            auto item = list.substr(pos, end - pos);
+            auto dash = item.find('-');
+            int  lo   = std::stoi(item.substr(0, dash));
+            int  hi   = dash == std::string::npos ? lo : std::stoi(item.substr(dash + 1));
+            for (int c = lo; c <= hi; ++c)
+                r.push_back(c);
+            pos = end == std::string::npos ? end : end + 1;
+        }
+        return r;
+    }
+
+    // -1 when the kernel doesn't tell (no NUMA, or no sysfs)
+    inline int node_of_cpu(int cpu) {
+        auto dir = ::opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+        if (!dir)
+            return -1;
+        int node = -1;
+        while (auto e = ::readdir(dir))
+            if (std::string_view(e->d_name).substr(0, 4) == "node")
+                node = std::atoi(e->d_name + 4);
+        ::closedir(dir);
+        return node;
+    }
+
+    inline int current_node() {
+        unsigned cpu = 0, node = 0;
+        if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+            return -1;
+        return int(node);
+    }
+
+    inline int nodes() {
+        int n = 0;
+        while (::access(("/sys/devices/system/node/node" + std::to_string(n)).c_str(), F_OK) == 0)
+            ++n;
+        return std::max(n, 1);
+    }
+
+    // the node all of the cpus are on, or -1 if they straddle nodes
+    inline int node_of(cpus const& cs) {
+        int node = -1;
+        for (auto c : cs) {
+            int n = node_of_cpu(c);
+            if (n < 0 || (node >= 0 && n != node))
+                return -1;
+            node = n;
+        }
+        return node;
+    }
+
+    // new pages of the calling thread come from `node` while it has memory
+    inline bool prefer_node(int node) {
+        if (node < 0)
+            return false;
+        unsigned long mask = 1ul << node;
+        return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) == 0;
+    }
+
+    // places [p, p+len) (page aligned) on `node`; pages already touched move along
+    inline bool bind_memory(void* p, size_t len, int node) {
+        unsigned long mask = 1ul << node;
+        return ::syscall(SYS_mbind, p, len, MPOL_BIND, &mask, sizeof(mask) * 8, MPOL_MF_MOVE) == 0;
+    }
+
+    inline bool pin(pthread_t th, cpus const& cs) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto c : cs)
+            CPU_SET(c, &set);
+        return ::pthread_setaffinity_np(th, sizeof(set), &set) == 0;
+    }
+
+    // pins the calling thread and, when the cpus share a node, prefers its memory
+    inline bool pin_this_thread(cpus const& cs) {
+        if (cs.empty())
+            return false;
+        if (!pin(::pthread_self(), cs))
+            return false;
+        prefer_node(node_of(cs));
+        return true;
+    }
+
+    // cpu `i` of a list that threads are dealt from round-robin
+    inline cpus nth(cpus const& cs, size_t i) {
+        if (cs.empty())
+            return {};
+        return {cs[i % cs.size()]};
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+#include "server.hpp"
+
+// What the loopback benches have in common: a server on an io thread of its
+// own, in-memory clients (loopback.hpp) that count the lines they read, and
+// broadcasts in bursts with the clients' reads in between.
+//
+// With BENCH_COUNT_ALLOCATIONS defined before it is included, the global
+// operator new and delete are replaced by ones that count, see
+// allocations(); every form of them, so that nothing is freed by a
+// mismatched one. Include it from the bench's only translation unit.
+namespace bench {
+    using clk = std::chrono::steady_clock;
+
+    // reads whatever the server sends; newline framing: a line per message
+    struct client {
+        explicit client(loopback::stream s) : s(std::move(s)) {}
+        virtual ~client() = default;
+
+        void read() {
+            s.async_read_some(ba::buffer(buf), [this](error_code ec, size_t n) {
+                    lines += std::count(buf.begin(), buf.begin() + n, '\n');
+                    on_read();
+                    if (!ec)
+                        read();
+                });
+        }
+
+        virtual void on_read() {} // after each read, on the io thread
+
+        loopback::stream  s;
+        uint64_t          lines = 0;
+        std::vector<char> buf = std::vector<char>(64 << 10);
+    };
+
+    struct fixture {
+        explicit fixture(server_options const& opts) : srv(ioc, opts) {}
+        ~fixture() {
+            srv.stop();
+            ioc.stop();
+            if (io.joinable())
+                io.join();
+            clients.clear(); // their reads die with the io_context, which owns the connections
+        }
+        fixture(fixture const&) = delete;
+        fixture& operator=(fixture const&) = delete;
+
+        // before start(); C is a client, constructed with the stream and `args`
+        template <typename C = client, typename... Args> C& connect(loopback::options to_client = {}, Args&&... args) {
+            clients.push_back(std::make_unique<C>(srv.connect_loopback(to_client), std::forward<Args>(args)...));
+            return static_cast<C&>(*clients.back());
+        }
+
+        // the clients read, the io thread runs; returns once the joins are delivered
+        void start() {
+            for (auto& c : clients)
+                post(ioc, [&c] { c->read(); });
+            io = std::thread([this] { ioc.run(); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        template <typename F> auto on_io(F f) { return ba::post(ioc, ba::use_future(std::move(f))).get(); }
+
+        uint64_t delivered() { // lines read, all clients
+            return on_io([this] {
+                uint64_t n = 0;
+                for (auto& c : clients)
+                    n += c->lines;
+                return n;
+            });
+        }
+
+        void wait_delivered(uint64_t n) {
+            while (delivered() < n)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        // `n` broadcasts of `msg`, 256 per io handler; how long each burst
+        // held the io thread
+        std::vector<clk::duration> broadcast(size_t n, std::string const& msg) {
+            std::vector<clk::duration> bursts;
+            for (size_t sent = 0; sent < n; sent += 256)
+                bursts.push_back(on_io([&, sent] {
+                    auto start = clk::now();
+                    for (size_t i = sent; i < std::min(n, sent + 256); ++i)
+                        srv.broadcast(msg);
+                    return clk::now() - start;
+                }));
+            return bursts;
+        }
+
+        ba::io_context                       ioc;
+        server                               srv;
+        std::vector<std::unique_ptr<client>> clients;
+        std::thread                          io;
+    };
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+namespace bench {
+    inline std::atomic<uint64_t> s_allocations{0};
+
+    inline uint64_t allocations() { return s_allocations.load(std::memory_order_relaxed); }
+
+    inline void* counted(size_t size, size_t align) {
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+        void* p = align > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? std::aligned_alloc(align, (size + align - 1) / align * align)
+                                                           : std::malloc(size ? size : 1);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    // out of line: inlined into a delete, free() is what -Wmismatched-new-delete sees
+    [[gnu::noinline]] inline void release(void* p) noexcept { std::free(p); }
+}
+
+void* operator new(size_t size) { return bench::counted(size, 0); }
+void* operator new[](size_t size) { return bench::counted(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return bench::counted(size, size_t(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return bench::counted(size, size_t(align)); }
+void operator delete(void* p) noexcept { bench::release(p); }
+void operator delete[](void* p) noexcept { bench::release(p); }
+void operator delete(void* p, size_t) noexcept { bench::release(p); }
+void operator delete[](void* p, size_t) noexcept { bench::release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { bench::release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { bench::release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { bench::release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { bench::release(p); }
+#endif
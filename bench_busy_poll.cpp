@@ -0,0 +1,89 @@
+// Wakeup-to-handler latency, blocking ioc.run() vs busy_poll::run().
+//
+// A sender thread writes its steady_clock timestamp over loopback TCP every
+// `gap`, so the io thread is idle in between; the read handler records how
+// long ago that was. With a spin longer than the gap the io thread never
+// blocks in epoll_wait. Spinning needs a core of its own: pin the io thread
+// and the sender apart (on one core they take turns, and it's only slower).
+//
+//  g++ -std=c++17 -O2 bench_busy_poll.cpp -o bench_busy_poll -pthread
+//  ./bench_busy_poll [gap_us] [io_cpu sender_cpu]
+#include "affinity.hpp"
+#include "busy_poll.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t samples = 20000;
+
+struct receiver {
+    tcp::socket&          s;
+    std::vector<double>&  lat;
+    int64_t               stamp;
+
+    void read() {
+        ba::async_read(s, ba::buffer(&stamp, sizeof(stamp)), [this](boost::system::error_code ec, size_t) {
+                if (ec) return;
+                auto now = clk::now().time_since_epoch().count();
+                lat.push_back((now - stamp) / 1e3);
+                read();
+            });
+    }
+};
+
+static void run(char const* name, std::chrono::microseconds spin, std::chrono::microseconds gap, affinity::cpus io_cpu,
+                affinity::cpus sender_cpu) {
+    ba::io_context ioc(1);
+    tcp::acceptor  acc(ioc, {ba::ip::address_v4::loopback(), 0});
+    tcp::socket    tx(ioc);
+    tx.connect(acc.local_endpoint());
+    tx.set_option(tcp::no_delay(true));
+    auto rx = acc.accept();
+    if (spin.count())
+        busy_poll::enable(rx.native_handle(), spin);
+
+    std::vector<double> lat;
+    lat.reserve(samples);
+    receiver r{rx, lat, 0};
+    r.read();
+
+    std::thread io([&] {
+        affinity::pin_this_thread(io_cpu);
+        busy_poll::run(ioc, spin);
+    });
+
+    affinity::pin_this_thread(sender_cpu);
+    for (size_t i = 0; i < samples; ++i) {
+        std::this_thread::sleep_for(gap);
+        int64_t stamp = clk::now().time_since_epoch().count();
+        ba::write(tx, ba::buffer(&stamp, sizeof(stamp)));
+    }
+    tx.shutdown(tcp::socket::shutdown_send);
+    io.join();
+
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) { return lat[std::min(lat.size() - 1, size_t(p / 100 * lat.size()))]; };
+    std::printf("%-14s p50 %7.1f us  p90 %7.1f us  p99 %7.1f us  p99.9 %7.1f us\n", name, pct(50), pct(90), pct(99),
+                pct(99.9));
+}
+
+int main(int argc, char** argv) {
+    using std::chrono::microseconds;
+    auto gap = microseconds(argc > 1 ? std::stoul(argv[1]) : 100);
+    affinity::cpus io_cpu, sender_cpu;
+    if (argc > 3) {
+        io_cpu     = {std::stoi(argv[2])};
+        sender_cpu = {std::stoi(argv[3])};
+    }
+    std::printf("%zu messages, one every %lld us, %u cpus\n", samples, static_cast<long long>(gap.count()),
+                std::thread::hardware_concurrency());
+
+    run("blocking", microseconds(0), gap, io_cpu, sender_cpu);
+    run("spin gap/2", gap / 2, gap, io_cpu, sender_cpu);
+    run("spin 10 x gap", gap * 10, gap, io_cpu, sender_cpu);
+}
@@ -0,0 +1,50 @@
+// Callback chains vs coroutines (-DBROADCAST_COROUTINES, coro.hpp) for the
+// connection loops: broadcasts to in-memory clients (loopback.hpp), everything
+// on the io thread, counting heap allocations per delivered message and, in a
+// coroutine build, how many coroutine frames were fresh vs recycled.
+//
+//  g++ -std=c++17 -O2 bench_coroutines.cpp -o bench_callbacks -pthread -lz
+//  g++ -std=c++20 -O2 -DBROADCAST_COROUTINES bench_coroutines.cpp -o bench_coroutines -pthread -lz
+//  ./bench_coroutines [clients] [messages]
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench.hpp"
+#include <cstdio>
+
+using bench::clk;
+
+int main(int argc, char** argv) {
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    size_t n_clients = argc > 1 ? std::stoul(argv[1]) : 64;
+    size_t n_msgs    = argc > 2 ? std::stoul(argv[2]) : 20000;
+
+    server_options opts;
+    opts.framing = framing::mode::newline;
+    bench::fixture f(opts);
+    for (size_t i = 0; i < n_clients; ++i)
+        f.connect();
+    f.start();
+
+    auto lines0 = f.delivered();
+#ifdef BROADCAST_COROUTINES
+    auto frames0 = f.on_io([] { return coro::frame_pool::get_stats(); });
+#endif
+
+    std::string msg(100, 'x');
+    auto allocs0 = bench::allocations();
+    auto start   = clk::now();
+    f.broadcast(n_msgs, msg);
+    f.wait_delivered(lines0 + n_clients * n_msgs);
+    auto secs   = std::chrono::duration<double>(clk::now() - start).count();
+    auto allocs = bench::allocations() - allocs0;
+
+#ifdef BROADCAST_COROUTINES
+    auto frames = f.on_io([] { return coro::frame_pool::get_stats(); });
+    std::printf("coroutines, %zu clients x %zu messages: %.2f allocations per delivered message, %.2f M msgs/s, "
+                "%zu coroutine frames allocated, %zu recycled\n",
+                n_clients, n_msgs, double(allocs) / (n_clients * n_msgs), n_clients * n_msgs / secs / 1e6,
+                frames.fresh - frames0.fresh, frames.recycled - frames0.recycled);
+#else
+    std::printf("callbacks, %zu clients x %zu messages: %.2f allocations per delivered message, %.2f M msgs/s\n",
+                n_clients, n_msgs, double(allocs) / (n_clients * n_msgs), n_clients * n_msgs / secs / 1e6);
+#endif
+}
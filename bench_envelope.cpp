@@ -0,0 +1,136 @@
+// Envelopes on the real write path: the server broadcasts to an in-memory
+// binary client (loopback.hpp) that did or did not announce cap_envelope in
+// its hello, so what is measured is basic_connection's own packing. The
+// client decodes every frame, envelopes with envelope::unpack, and checks
+// that each message arrives once, in order and intact.
+//
+// Every 100th message is larger than envelope::max_entry, so it goes out in a
+// frame of its own, between envelopes.
+//
+//  g++ -std=c++17 -O2 bench_envelope.cpp -o bench_envelope -pthread -lz
+//  ./bench_envelope [messages]
+#include "server.hpp"
+#include <cstdio>
+#include <future>
+#include <random>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+static std::vector<std::string> make_messages(size_t n, size_t avg) {
+    std::mt19937 prng(42);
+    std::uniform_int_distribution<size_t> len(avg / 2, avg + avg / 2);
+    std::vector<std::string> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = "#" + std::to_string(i) + ":";
+        size_t size = i % 100 == 99 ? envelope::max_entry + 100 : len(prng);
+        v[i].resize(std::max(size, v[i].size()), char('a' + i % 26));
+    }
+    return v;
+}
+
+// reads frames off the stream, unpacks envelopes, checks the sequence
+struct client {
+    client(loopback::stream s, std::vector<std::string> const& expect) : s(std::move(s)), expect(expect) {}
+
+    void read() {
+        s.async_read_some(ba::buffer(buf), [this](error_code ec, size_t n) {
+                ++reads;
+                bytes += n;
+                pending.append(buf.data(), n);
+                parse();
+                if (!ec)
+                    read();
+            });
+    }
+
+    void parse() {
+        size_t off = 0;
+        while (pending.size() - off >= framing::header_size) {
+            auto h = framing::header::decode(reinterpret_cast<uint8_t const*>(pending.data() + off));
+            if (pending.size() - off < framing::header_size + h.size)
+                break;
+            std::string_view body(pending.data() + off + framing::header_size, h.size);
+            off += framing::header_size + h.size;
+            ++frames;
+
+            if (h.flags & framing::flag_envelope) {
+                ++envelopes;
+                if (!envelope::unpack(body, [this](std::string_view entry, bool deflated) { got(entry, deflated); }))
+                    ++errors;
+            } else {
+                got(body, h.flags & framing::flag_deflate);
+            }
+        }
+        pending.erase(0, off);
+    }
+
+    void got(std::string_view msg, bool deflated) {
+        if (msg.substr(0, 8) == "player #") // the join announcement
+            return;
+        if (deflated || next >= expect.size() || msg != expect[next])
+            ++errors;
+        ++next;
+    }
+
+    loopback::stream                s;
+    std::vector<std::string> const& expect;
+    size_t                          next = 0, frames = 0, envelopes = 0, reads = 0, bytes = 0, errors = 0;
+    std::string                     pending;
+    std::vector<char>               buf = std::vector<char>(64 << 10);
+};
+
+static bool bench(std::vector<std::string> const& msgs, size_t avg, bool use_envelope) {
+    ba::io_context ioc;
+    server_options opts;
+    opts.framing = framing::mode::length_prefixed;
+    server srv(ioc, opts);
+
+    client c(srv.connect_loopback(), msgs);
+    uint8_t hello = framing::hello_magic | (use_envelope ? framing::cap_envelope : 0);
+    post(ioc, [&] {
+        ba::async_write(c.s, ba::buffer(&hello, 1), [](error_code, size_t) {});
+        c.read();
+    });
+    std::thread io([&] { ioc.run(); });
+    auto on_io = [&ioc](auto f) { return ba::post(ioc, ba::use_future(std::move(f))).get(); };
+    std::this_thread::sleep_for(50ms); // hello read, join delivered
+    auto bytes0 = on_io([&] { return c.bytes; });
+
+    size_t payload = 0;
+    for (auto& m : msgs)
+        payload += m.size();
+
+    auto start = clk::now();
+    for (size_t sent = 0; sent < msgs.size(); sent += 256) // in order, behind what is queued, like the feed
+        on_io([&, sent] {
+            return srv.broadcast_batch({msgs.begin() + sent, msgs.begin() + std::min(msgs.size(), sent + 256)}, false);
+        });
+    while (on_io([&] { return c.next; }) < msgs.size())
+        std::this_thread::sleep_for(1ms);
+    double secs = std::chrono::duration<double>(clk::now() - start).count();
+
+    auto [frames, envelopes, reads, bytes, errors, next] =
+        on_io([&] { return std::tuple{c.frames, c.envelopes, c.reads, c.bytes - bytes0, c.errors, c.next}; });
+    std::printf("%5zu B %-9s %7.2f M msgs/s  frames: %8zu (%7zu envelopes)  reads: %7zu  overhead: %5.2f B/msg  %s\n",
+                avg, use_envelope ? "envelope" : "frame", msgs.size() / secs / 1e6, frames, envelopes, reads,
+                double(bytes - payload) / msgs.size(), errors || next != msgs.size() ? "MISMATCH" : "in order, intact");
+
+    srv.stop();
+    ioc.stop();
+    io.join();
+    return !errors && next == msgs.size();
+}
+
+int main(int argc, char** argv) {
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 200'000;
+    bool ok = true;
+    for (size_t avg : {16, 64, 256}) {
+        auto msgs = make_messages(n, avg);
+        for (bool env : {false, true})
+            ok &= bench(msgs, avg, env);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Replaying a large newline-framed file through the feed stage: mmap'd file
+// vs the same bytes through a pipe, with no audience (split + prepare only)
+// and with loopback clients that read everything. Reports MB/s and messages/s
+// of the feed, end to end (until the last client has the last byte).
+//
+//  g++ -std=c++17 -O2 bench_feed.cpp -o bench_feed -pthread -lz
+//  ./bench_feed [GiB] [clients]    # writes /tmp/bench_feed.txt once
+#include "server.hpp"
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+static char const* path = "/tmp/bench_feed.txt";
+
+static uint64_t make_file(double gib) { // ~100 byte "market data" lines
+    uint64_t want = uint64_t(gib * (1ull << 30));
+    struct stat st;
+    if (::stat(path, &st) == 0 && uint64_t(st.st_size) >= want)
+        return st.st_size;
+
+    std::ofstream out(path, std::ios::binary);
+    std::string line;
+    uint64_t n = 0;
+    for (uint64_t seq = 0; n < want; ++seq) {
+        line = "seq=" + std::to_string(seq) + " sym=SYM" + std::to_string(seq % 997) + " px=" +
+            std::to_string(10000 + seq % 5000) + " qty=" + std::to_string(seq % 300) + " side=" + "BS"[seq & 1] +
+            std::string(40, 'x') + '\n';
+        out << line;
+        n += line.size();
+    }
+    return n;
+}
+
+static void bench(char const* name, uint64_t size, size_t n_clients, bool through_pipe) {
+    ba::io_context ioc;
+    server_options opts;
+    opts.framing = framing::mode::newline;
+    server srv(ioc, opts);
+
+    ba::io_context cli;
+    std::vector<tcp::socket> clients;
+    for (size_t i = 0; i < n_clients; ++i)
+        clients.emplace_back(cli).connect({ba::ip::address_v4::loopback(), 6767});
+    std::thread io([&] { ioc.run(); });
+    std::this_thread::sleep_for(200ms);
+    std::vector<char> buf(1 << 20);
+    for (auto& c : clients) // "has entered"
+        while (c.available())
+            c.read_some(ba::buffer(buf));
+
+    std::string feed_path = path;
+    std::thread writer;
+    int pipe_fds[2];
+    if (through_pipe) {
+        if (::pipe(pipe_fds) != 0)
+            return std::perror("pipe");
+        ::fcntl(pipe_fds[1], F_SETPIPE_SZ, 1 << 20);
+        feed_path = "/dev/fd/" + std::to_string(pipe_fds[0]);
+        writer = std::thread([fd = pipe_fds[1]] {
+            std::vector<char> chunk(1 << 20);
+            int in = ::open(path, O_RDONLY);
+            for (ssize_t n; (n = ::read(in, chunk.data(), chunk.size())) > 0;)
+                for (ssize_t off = 0; off < n;)
+                    off += ::write(fd, chunk.data() + off, n - off);
+            ::close(in);
+            ::close(fd);
+        });
+    }
+
+    std::promise<feed::stats> fed;
+    auto start = clk::now();
+    feed::source src(ioc, feed_path, framing::mode::newline,
+            [&](feed::batch b) { srv.broadcast_batch(std::move(b), false); },
+            [&] { return srv.longest_queue() >= opts.feed_backlog; });
+    src.start([&](feed::stats const& st) { fed.set_value(st); });
+
+    std::vector<std::thread> readers;
+    for (auto& c : clients)
+        readers.emplace_back([&c, size] {
+            std::vector<char> buf(1 << 20);
+            for (uint64_t got = 0; got < size;)
+                got += c.read_some(ba::buffer(buf));
+        });
+    for (auto& r : readers)
+        r.join();
+    auto st   = fed.get_future().get();
+    auto secs = std::chrono::duration<double>(clk::now() - start).count();
+
+    std::printf("%-6s %2zu clients  %8.1f MB/s  %6.2f M msgs/s  (%llu msgs, %llu batches, %llu stalls)\n", name,
+                n_clients, st.bytes / secs / 1e6, st.messages / secs / 1e6, (unsigned long long)st.messages,
+                (unsigned long long)st.batches, (unsigned long long)st.stalls);
+
+    if (writer.joinable())
+        writer.join();
+    if (through_pipe)
+        ::close(pipe_fds[0]);
+    clients.clear(); // clients close first, no TIME_WAIT on the listening port
+    std::this_thread::sleep_for(100ms);
+    srv.stop();
+    ioc.stop();
+    io.join();
+}
+
+int main(int argc, char** argv) {
+    s_verbose = false;
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    double gib     = argc > 1 ? std::stod(argv[1]) : 2;
+    size_t clients = argc > 2 ? std::stoul(argv[2]) : 4;
+
+    auto size = make_file(gib);
+    std::printf("%s: %.2f GiB\n", path, size / double(1ull << 30));
+    for (bool through_pipe : {false, true}) {
+        bench(through_pipe ? "pipe" : "mmap", size, 0, through_pipe);
+        bench(through_pipe ? "pipe" : "mmap", size, clients, through_pipe);
+    }
+}
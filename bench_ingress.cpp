@@ -0,0 +1,90 @@
+// Producer-side cost of broadcasting from game-logic threads: server::broadcast()
+// (takes the registry lock, then posts once per connection) vs
+// server::publish() (one CAS into the ingress queue; the io thread fans out
+// batches). Reports the time producers spend per event and until the last
+// connection has received everything.
+//
+//  g++ -std=c++17 -O2 bench_ingress.cpp -o bench_ingress -pthread -lz
+//  ./bench_ingress [producers] [connections]
+#include "server.hpp"
+#include <cstdio>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+static constexpr size_t events = 2000; // per producer
+
+static void bench(size_t producers, size_t n, bool ingress) {
+    ba::io_context ioc;
+    server_options opts;
+    opts.framing          = framing::mode::newline;
+    opts.ingress_capacity = 1 << 16;
+    server srv(ioc, opts);
+    std::thread io([&] { ioc.run(); });
+
+    ba::io_context cli;
+    std::vector<tcp::socket> clients;
+    for (size_t i = 0; i < n; ++i)
+        clients.emplace_back(cli).connect({ba::ip::address_v4::loopback(), 6767});
+    std::vector<char> buf(1 << 20);
+    for (bool quiet = false; !quiet;) { // until the "has entered" broadcasts are through
+        std::this_thread::sleep_for(200ms);
+        quiet = true;
+        for (auto& c : clients) {
+            while (c.available()) {
+                c.read_some(ba::buffer(buf));
+                quiet = false;
+            }
+        }
+    }
+
+    std::string msg(31, 'e');
+    std::atomic<int64_t> producer_ns{0};
+    auto start = clk::now();
+    std::vector<std::thread> th;
+    for (size_t p = 0; p < producers; ++p)
+        th.emplace_back([&] {
+            auto t0 = clk::now();
+            for (size_t i = 0; i < events; ++i)
+                if (ingress)
+                    while (!srv.publish(msg))
+                        std::this_thread::yield();
+                else
+                    srv.broadcast(msg);
+            producer_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clk::now() - t0).count();
+        });
+    for (auto& t : th)
+        t.join();
+
+    size_t expect = producers * events * (msg.size() + 1);
+    std::vector<size_t> got(n);
+    for (bool done = false; !done;) {
+        done = true;
+        for (size_t i = 0; i < n; ++i) {
+            if (got[i] < expect)
+                got[i] += clients[i].read_some(ba::buffer(buf.data(), std::min(buf.size(), expect - got[i])));
+            done &= got[i] == expect;
+        }
+    }
+    double all_ms = std::chrono::duration<double, std::milli>(clk::now() - start).count();
+
+    std::printf("%2zu producers %5zu conns  %-9s %8.2f us/event in producers  %8.1f ms until delivered\n", producers,
+                n, ingress ? "publish" : "broadcast", producer_ns / 1e3 / (producers * events), all_ms);
+
+    clients.clear(); // clients close first, no TIME_WAIT on the listening port
+    std::this_thread::sleep_for(100ms);
+    srv.stop();
+    ioc.stop();
+    io.join();
+}
+
+int main(int argc, char** argv) {
+    s_verbose = false;
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    size_t producers = argc > 1 ? std::stoul(argv[1]) : 4;
+    size_t n         = argc > 2 ? std::stoul(argv[2]) : 100;
+    for (bool ingress : {false, true})
+        bench(producers, n, ingress);
+}
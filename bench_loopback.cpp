@@ -0,0 +1,94 @@
+// Broadcast fan-out to in-memory clients (loopback.hpp): the server's queuing
+// and write path without the kernel's, so runs are repeatable.
+//
+// First every client drains as fast as it can: messages/s delivered, i.e.
+// what the per-connection work costs. Then one client is slow (a capped
+// drain rate): how far its queue grows while the others finish, and how long
+// it takes to catch up.
+//
+//  g++ -std=c++17 -O2 bench_loopback.cpp -o bench_loopback -pthread -lz
+//  ./bench_loopback [clients] [messages] [size] [slow MB/s]
+#include "bench.hpp"
+#include <cstdio>
+
+using bench::clk;
+
+// done() once it has `want` lines
+struct timed_client : bench::client {
+    timed_client(loopback::stream s, uint64_t want, std::function<void()> const& done)
+        : client(std::move(s)), want(want), done(done) {}
+
+    void on_read() override {
+        if (lines >= want && finished == clk::time_point{}) {
+            finished = clk::now();
+            done();
+        }
+    }
+
+    uint64_t                     want;
+    std::function<void()> const& done;
+    clk::time_point              finished{};
+};
+
+static void run(size_t n_clients, size_t n_msgs, size_t size, double slow_rate) {
+    std::promise<void> all_done;
+    std::atomic<size_t> remaining{n_clients};
+    std::function<void()> done = [&] {
+        if (--remaining == 0)
+            all_done.set_value();
+    };
+
+    server_options opts;
+    opts.framing = framing::mode::newline;
+    bench::fixture f(opts); // stops the io thread before `done` goes
+    std::vector<timed_client*> clients;
+    for (size_t i = 0; i < n_clients; ++i) {
+        loopback::options to_client;
+        if (slow_rate && i == 0)
+            to_client.rate = slow_rate;
+        // the "has entered" of itself and everyone after it, then the broadcasts
+        clients.push_back(&f.connect<timed_client>(to_client, n_clients - i + n_msgs, done));
+    }
+    f.start();
+
+    std::string msg(size, 'x');
+    size_t longest = 0, sent = 0;
+    std::function<void()> burst = [&] { // on the io thread, 256 at a time with the clients' reads in between
+        for (size_t end = std::min(n_msgs, sent + 256); sent < end; ++sent)
+            f.srv.broadcast(msg);
+        longest = std::max(longest, f.srv.longest_queue());
+        if (sent < n_msgs)
+            post(f.ioc, burst);
+    };
+    auto start = clk::now();
+    post(f.ioc, burst);
+    all_done.get_future().get();
+    auto end = clk::now();
+
+    auto secs = [start](clk::time_point t) { return std::chrono::duration<double>(t - start).count(); };
+    clk::time_point fast_done = start;
+    for (size_t i = slow_rate ? 1 : 0; i < n_clients; ++i)
+        fast_done = std::max(fast_done, clients[i]->finished);
+
+    if (slow_rate)
+        std::printf("%3zu clients, 1 at %5.1f MB/s  others done %7.3f s, slow one %7.3f s, longest queue %zu\n",
+                    n_clients, slow_rate / 1e6, secs(fast_done), secs(clients[0]->finished), longest);
+    else
+        std::printf("%3zu clients              %8.3f s  %6.2f M msgs/s delivered, longest queue %zu\n", n_clients,
+                    secs(end), n_clients * n_msgs / secs(end) / 1e6, longest);
+}
+
+int main(int argc, char** argv) {
+    s_verbose = false;
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    size_t clients = argc > 1 ? std::stoul(argv[1]) : 64;
+    size_t msgs    = argc > 2 ? std::stoul(argv[2]) : 20000;
+    size_t size    = argc > 3 ? std::stoul(argv[3]) : 100;
+    double slow    = (argc > 4 ? std::stod(argv[4]) : 1) * 1e6;
+
+    std::printf("%zu messages of %zu bytes\n", msgs, size);
+    for (size_t n : {size_t(1), clients / 4, clients})
+        run(std::max<size_t>(n, 1), msgs, size, 0);
+    run(clients, msgs, size, slow);
+}
@@ -0,0 +1,97 @@
+// Cross-node penalty for connection buffers. An I/O thread pinned to each
+// node works through the rx and tx buffers of its connections (copy rx to tx,
+// then a dependent walk through the rx side, like parsing), with the buffers
+// placed
+//   owner     on the I/O thread's node (shards, with or without
+//             accept_thread: constructed on the I/O thread, pinned with -C)
+//   acceptor  on the accepting thread's node (node 0 here), which is where
+//             they land when the acceptor allocates them unpinned
+//
+// On a single-node machine both rows are the same; the output says so.
+//
+//  g++ -std=c++17 -O2 bench_numa.cpp -o bench_numa -pthread
+//  ./bench_numa [connections]
+#include "affinity.hpp"
+#include <sys/mman.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t buf_size = 64 << 10; // per direction
+static constexpr int    passes   = 20;
+
+struct result {
+    double gbps, walk_ns;
+};
+
+static result run(int cpu, int mem_node, size_t conns) {
+    result r{};
+    std::thread([&] {
+        affinity::pin_this_thread({cpu});
+        size_t len = conns * 2 * buf_size;
+        auto   mem = static_cast<char*>(::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mem == MAP_FAILED)
+            return std::perror("mmap");
+        if (!affinity::bind_memory(mem, len, mem_node))
+            std::perror("mbind");
+        std::memset(mem, 1, len); // fault in, on mem_node
+
+        // the rx halves double as a shuffled ring of cache-line indices
+        size_t lines = conns * buf_size / 64;
+        std::vector<uint32_t> order(lines);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(42));
+        auto rx_line = [&](size_t i) { return reinterpret_cast<uint32_t*>(mem + (i / (buf_size / 64)) * 2 * buf_size + (i % (buf_size / 64)) * 64); };
+
+        auto t0 = clk::now();
+        for (int p = 0; p < passes; ++p)
+            for (size_t c = 0; c < conns; ++c)
+                std::memcpy(mem + (2 * c + 1) * buf_size, mem + 2 * c * buf_size, buf_size);
+        double secs = std::chrono::duration<double>(clk::now() - t0).count();
+        r.gbps = double(passes) * conns * buf_size / secs / 1e9;
+
+        for (size_t i = 0; i < lines; ++i) // the copies overwrote the links
+            *rx_line(order[i]) = order[(i + 1) % lines];
+        uint32_t at = order[0];
+        t0 = clk::now();
+        for (size_t i = 0; i < lines; ++i)
+            at = *rx_line(at);
+        r.walk_ns = std::chrono::duration<double, std::nano>(clk::now() - t0).count() / lines;
+        asm volatile("" ::"r"(at)); // keep the walk
+
+        ::munmap(mem, len);
+    }).join();
+    return r;
+}
+
+int main(int argc, char** argv) {
+    size_t conns = argc > 1 ? std::stoul(argv[1]) : 256;
+    int    nodes = affinity::nodes();
+
+    std::vector<int> cpu_of_node(nodes, -1);
+    for (int c = 0, n = int(std::thread::hardware_concurrency()); c < n; ++c) {
+        int node = affinity::node_of_cpu(c);
+        if (node >= 0 && node < nodes && cpu_of_node[node] < 0)
+            cpu_of_node[node] = c;
+    }
+
+    std::printf("%d node(s), %zu connections x 2 x %zu KiB\n", nodes, conns, buf_size >> 10);
+    if (nodes == 1)
+        std::printf("single node: no cross-node traffic to avoid, pinning only\n");
+
+    for (int node = 0; node < nodes; ++node) {
+        int cpu = cpu_of_node[node];
+        if (cpu < 0)
+            continue; // memory-only node
+        auto owner    = run(cpu, node, conns);
+        auto acceptor = run(cpu, 0, conns);
+        std::printf("io thread cpu %3d node %d  owner    %6.2f GB/s  %6.1f ns/line\n", cpu, node, owner.gbps, owner.walk_ns);
+        std::printf("%25s acceptor %6.2f GB/s  %6.1f ns/line%s\n", "", acceptor.gbps, acceptor.walk_ns,
+                    node == 0 ? "  (same node)" : "");
+    }
+}
@@ -0,0 +1,44 @@
+// Reference counting per delivered message: broadcasts to in-memory clients
+// (loopback.hpp), everything on the io thread, counting the connections'
+// add_ref/release/try_ref calls. In the default build each of those is a
+// locked read-modify-write; in a single-threaded build none is.
+//
+//  g++ -std=c++17 -O2 -DBROADCAST_COUNT_REFS bench_refcount.cpp -o bench_refcount -pthread -lz
+//  g++ -std=c++17 -O2 -DBROADCAST_COUNT_REFS -DBROADCAST_SINGLE_THREADED bench_refcount.cpp -o bench_refcount_st -pthread -lz
+//  ./bench_refcount [clients] [messages]
+#include "bench.hpp"
+#include <cstdio>
+
+#ifndef BROADCAST_COUNT_REFS
+#error "build with -DBROADCAST_COUNT_REFS"
+#endif
+
+using bench::clk;
+
+int main(int argc, char** argv) {
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    size_t n_clients = argc > 1 ? std::stoul(argv[1]) : 64;
+    size_t n_msgs    = argc > 2 ? std::stoul(argv[2]) : 20000;
+
+    server_options opts;
+    opts.framing = framing::mode::newline;
+    bench::fixture f(opts);
+    for (size_t i = 0; i < n_clients; ++i)
+        f.connect();
+    f.start();
+
+    auto lines0 = f.delivered();
+    auto ops0   = f.on_io([] { return s_ref_ops; });
+
+    auto start = clk::now();
+    f.broadcast(n_msgs, std::string(100, 'x'));
+    f.wait_delivered(lines0 + n_clients * n_msgs);
+    auto secs = std::chrono::duration<double>(clk::now() - start).count();
+    auto ops  = f.on_io([] { return s_ref_ops; }) - ops0;
+
+    bool locked = policy::default_threading::concurrent;
+    std::printf("%s build, %zu clients x %zu messages: %.2f reference count ops per delivered message (%s), "
+                "%.2f M msgs/s\n",
+                locked ? "default" : "single-threaded", n_clients, n_msgs, double(ops) / (n_clients * n_msgs),
+                locked ? "all locked RMW" : "no atomics", n_clients * n_msgs / secs / 1e6);
+}
@@ -0,0 +1,90 @@
+// Writer-to-reader latency through the shared-memory ring, reader in a separate
+// process, and what a reader that can't keep up sees (lapping).
+//
+//  g++ -std=c++17 -O2 bench_shm_ring.cpp -o bench_shm_ring
+#include "shm_ring.hpp"
+#include <sched.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static constexpr char const* ring_name = "/bench_shm_ring";
+
+static uint64_t now_ns() { // CLOCK_MONOTONIC, comparable across processes
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+static int run_reader(size_t count, bool slow) {
+    shm_ring::reader ring(ring_name);
+    std::vector<double> lat;
+    lat.reserve(count);
+
+    std::string msg;
+    for (size_t seen = 0; seen < count;) {
+        switch (ring.read(msg)) {
+            case shm_ring::reader::status::ok: {
+                uint64_t sent;
+                std::memcpy(&sent, msg.data(), sizeof(sent));
+                if (sent == 0) // end marker
+                    seen = count;
+                else
+                    lat.push_back((now_ns() - sent) / 1e3);
+                ++seen;
+                if (slow) // simulates per-message work
+                    for (auto t = now_ns(); now_ns() - t < 2000;) {}
+                break;
+            }
+            case shm_ring::reader::status::lapped: break;
+            case shm_ring::reader::status::empty: ::sched_yield(); break;
+        }
+    }
+
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) { return lat.empty() ? 0 : lat[size_t(p * (lat.size() - 1))]; };
+    std::printf("%-6s received %7zu  lost %7llu  latency p50 %6.2f us  p99 %7.2f us  p99.9 %7.2f us\n",
+                slow ? "slow" : "fast", lat.size(), (unsigned long long)ring.lost(), pct(.5), pct(.99),
+                pct(.999));
+    std::fflush(stdout); // we leave by _exit
+    return 0;
+}
+
+static void run(size_t count, size_t size, uint64_t interval_ns, bool slow_reader) {
+    shm_ring::writer ring(ring_name, 4096, 256);
+
+    std::fflush(stdout);
+    pid_t child = ::fork();
+    if (child == 0)
+        ::_exit(run_reader(count, slow_reader)); // skip the writer's destructor
+
+    ::usleep(100'000); // let the reader attach
+
+    std::string msg(size, 'x');
+    auto start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        for (auto t = now_ns(); interval_ns && now_ns() - t < interval_ns;)
+            ::sched_yield(); // one core here: let the reader run
+        uint64_t ts = now_ns();
+        std::memcpy(msg.data(), &ts, sizeof(ts));
+        ring.publish(msg);
+    }
+    auto secs = (now_ns() - start) / 1e9;
+
+    uint64_t end = 0;
+    std::memcpy(msg.data(), &end, sizeof(end));
+    while (::waitpid(child, nullptr, WNOHANG) == 0) { // keep nudging until it sees the marker
+        ring.publish(msg);
+        ::usleep(1000);
+    }
+    std::printf("       writer %.2f Mmsg/s (%zu B, %s)\n", count / secs / 1e6, size,
+                interval_ns ? "paced" : "burst");
+}
+
+int main() {
+    run(200'000, 64, 5'000, false);   // paced: latency
+    run(2'000'000, 64, 0, false);     // burst: throughput, reader keeps up or gets lapped
+    run(200'000, 64, 0, true);        // slow reader: lapping is detected and counted
+}
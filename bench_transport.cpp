@@ -0,0 +1,102 @@
+// Loopback TCP vs AF_UNIX stream socket, against the echo server itself:
+// round-trip latency percentiles and echo throughput.
+//
+//  g++ -std=c++17 -O2 bench_transport.cpp -o bench_transport -pthread -lz
+#include "server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+using ba::local::stream_protocol;
+
+static constexpr char const* uds_path = "/tmp/bench_transport.sock";
+
+template <typename Socket> static void skip_join_broadcast(Socket& s, ba::streambuf& rx) {
+    ba::read_until(s, rx, "\n");
+    rx.consume(rx.size());
+}
+
+template <typename Socket> static void bench_latency(char const* name, Socket s, size_t rounds) {
+    ba::streambuf rx;
+    skip_join_broadcast(s, rx);
+
+    std::string ping(63, 'p');
+    ping += '\n';
+    std::vector<double> rtt;
+    rtt.reserve(rounds);
+    for (size_t i = 0; i < rounds; ++i) {
+        auto start = clk::now();
+        ba::write(s, ba::buffer(ping));
+        auto n = ba::read_until(s, rx, "\n");
+        rx.consume(n);
+        rtt.push_back(std::chrono::duration<double, std::micro>(clk::now() - start).count());
+    }
+
+    std::sort(rtt.begin(), rtt.end());
+    auto pct = [&](double p) { return rtt[size_t(p * (rtt.size() - 1))]; };
+    std::printf("%-4s rtt  p50 %7.1f us  p99 %7.1f us  p99.9 %7.1f us\n", name, pct(.5), pct(.99), pct(.999));
+}
+
+template <typename Socket> static void bench_throughput(char const* name, Socket s, size_t lines, size_t len) {
+    ba::streambuf rx;
+    skip_join_broadcast(s, rx);
+
+    std::string line(len - 1, 't');
+    line += '\n';
+    std::string batch;
+    for (int i = 0; i < 64; ++i)
+        batch += line;
+
+    auto start = clk::now();
+    std::thread writer([&] {
+        for (size_t i = 0; i < lines / 64; ++i)
+            ba::write(s, ba::buffer(batch));
+    });
+
+    size_t expected = lines / 64 * batch.size(), received = 0;
+    std::vector<char> buf(1 << 16);
+    while (received < expected)
+        received += s.read_some(ba::buffer(buf));
+    writer.join();
+
+    double secs = std::chrono::duration<double>(clk::now() - start).count();
+    std::printf("%-4s echo %7.1f MB/s  %6.2f Mlines/s (%zu B lines)\n", name, received / secs / 1e6,
+                lines / secs / 1e6, len);
+}
+
+int main() {
+    ba::io_context ioc;
+    server_options opts;
+    opts.framing   = framing::mode::newline;
+    opts.unix_path = uds_path;
+    server srv(ioc, opts);
+    std::thread io([&] { ioc.run(); });
+
+    ba::io_context cli;
+    auto tcp_client = [&] {
+        tcp::socket s(cli);
+        s.connect({ba::ip::address_v4::loopback(), 6767});
+        s.set_option(tcp::no_delay(true));
+        return s;
+    };
+    auto uds_client = [&] {
+        stream_protocol::socket s(cli);
+        s.connect(stream_protocol::endpoint(uds_path));
+        return s;
+    };
+
+    for (int round = 0; round < 2; ++round) {
+        bench_latency("tcp", tcp_client(), 20000);
+        bench_latency("uds", uds_client(), 20000);
+    }
+    for (size_t len : {64, 1024}) {
+        bench_throughput("tcp", tcp_client(), 1 << 20, len);
+        bench_throughput("uds", uds_client(), 1 << 20, len);
+    }
+
+    srv.stop();
+    ioc.stop();
+    io.join();
+}
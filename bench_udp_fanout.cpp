@@ -0,0 +1,128 @@
+// Fan-out cost of small state updates to N local recipients: one TCP write per
+// connection, one UDP sendto per endpoint, and udp_fanout::sender (sendmmsg,
+// with and without UDP GSO for multi-message ticks).
+//
+//  g++ -std=c++17 -O2 bench_udp_fanout.cpp -o bench_udp_fanout -pthread
+#include "udp_fanout.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using ba::ip::udp;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t msg_size = 64;
+static constexpr int    ticks    = 50;
+
+struct result {
+    double us_per_tick;
+    double syscalls_per_tick;
+};
+
+static void print(char const* name, size_t n, size_t per_tick, result r) {
+    std::printf("%6zu recipients %2zu msg/tick  %-14s %9.1f us/tick  %8.1f syscalls/tick\n", n, per_tick,
+                name, r.us_per_tick, r.syscalls_per_tick);
+}
+
+template <typename F> static double time_ticks(F f) {
+    auto start = clk::now();
+    for (int i = 0; i < ticks; ++i)
+        f();
+    return std::chrono::duration<double, std::micro>(clk::now() - start).count() / ticks;
+}
+
+static result bench_tcp(ba::io_context& ioc, size_t n, size_t per_tick) {
+    tcp::acceptor acc(ioc, {ba::ip::address_v4::loopback(), 0});
+    std::vector<tcp::socket> clients, conns;
+    for (size_t i = 0; i < n; ++i) {
+        clients.emplace_back(ioc).connect(acc.local_endpoint());
+        conns.push_back(acc.accept());
+        conns.back().set_option(tcp::no_delay(true));
+    }
+
+    std::string msg(msg_size + 1, 'x'); // newline framed
+    size_t syscalls = 0;
+    double us = time_ticks([&] {
+        for (auto& c : conns)
+            for (size_t m = 0; m < per_tick; ++m, ++syscalls)
+                ::write(c.native_handle(), msg.data(), msg.size());
+
+        for (auto& c : clients) { // keep the receive side from filling up
+            char buf[4096];
+            while (c.available())
+                c.read_some(ba::buffer(buf));
+        }
+    });
+    return {us, double(syscalls) / ticks};
+}
+
+static std::vector<udp::socket> make_receivers(ba::io_context& ioc, size_t n) {
+    std::vector<udp::socket> v;
+    for (size_t i = 0; i < n; ++i)
+        v.emplace_back(ioc, udp::endpoint{ba::ip::address_v4::loopback(), 0});
+    return v;
+}
+
+static void drain(std::vector<udp::socket>& receivers) {
+    char buf[65536];
+    for (auto& r : receivers)
+        while (r.available())
+            r.receive(ba::buffer(buf));
+}
+
+static result bench_sendto(ba::io_context& ioc, size_t n, size_t per_tick) {
+    auto receivers = make_receivers(ioc, n);
+    udp::socket s(ioc, udp::v4());
+    std::string msg(multicast::seq_size + msg_size, 'x');
+
+    size_t syscalls = 0;
+    double us = time_ticks([&] {
+        for (auto& r : receivers)
+            for (size_t m = 0; m < per_tick; ++m, ++syscalls) {
+                auto ep = r.local_endpoint();
+                ::sendto(s.native_handle(), msg.data(), msg.size(), 0, ep.data(), ep.size());
+            }
+        drain(receivers);
+    });
+    return {us, double(syscalls) / ticks};
+}
+
+static result bench_fanout(ba::io_context& ioc, size_t n, size_t per_tick, bool gso) {
+    auto receivers = make_receivers(ioc, n);
+    udp_fanout::sender sender(ioc, gso);
+    for (auto& r : receivers)
+        sender.subscribe(r.local_endpoint(), [] { return true; });
+
+    std::vector<udp_fanout::payload> tick;
+    for (size_t m = 0; m < per_tick; ++m)
+        tick.push_back(std::make_shared<std::string const>(msg_size, 'x'));
+
+    sender.send(tick); // warm up (and GSO probe)
+    drain(receivers);
+    auto before = sender.get_stats().syscalls;
+
+    double us = time_ticks([&] {
+        sender.send(tick);
+        drain(receivers);
+    });
+    auto st = sender.get_stats();
+    if (st.dropped)
+        std::printf("  (%zu datagrams dropped at the sender)\n", st.dropped);
+    return {us, double(st.syscalls - before) / ticks};
+}
+
+int main() {
+    ba::io_context ioc;
+    for (size_t n : {100, 1000, 5000}) {
+        for (size_t per_tick : {1, 8}) {
+            print("tcp write", n, per_tick, bench_tcp(ioc, n, per_tick));
+            print("udp sendto", n, per_tick, bench_sendto(ioc, n, per_tick));
+            print("sendmmsg", n, per_tick, bench_fanout(ioc, n, per_tick, false));
+            if (per_tick > 1)
+                print("sendmmsg+gso", n, per_tick, bench_fanout(ioc, n, per_tick, true));
+        }
+    }
+}
@@ -0,0 +1,93 @@
+// Broadcast fan-out to N local connections: per-connection Asio writes vs one
+// io_uring submission (server_options::io_uring). Reports the time until the
+// last recipient has the message, io thread CPU and submission syscalls per
+// broadcast (the Asio path makes one sendmsg per recipient).
+//
+//  g++ -std=c++17 -O2 bench_uring_fanout.cpp -o bench_uring_fanout -pthread -lz
+#include "server.hpp"
+#include <pthread.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+static constexpr int broadcasts = 100;
+
+static double cpu_secs(std::thread& th) {
+    clockid_t id;
+    timespec  ts;
+    pthread_getcpuclockid(th.native_handle(), &id);
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(size_t n, bool uring) {
+    ba::io_context ioc;
+    server_options opts;
+    opts.framing  = framing::mode::newline;
+    opts.io_uring = uring;
+    server srv(ioc, opts);
+    std::thread io([&] { ioc.run(); });
+
+    ba::io_context cli;
+    std::vector<tcp::socket> clients;
+    for (size_t i = 0; i < n; ++i) {
+        clients.emplace_back(cli).connect({ba::ip::address_v4::loopback(), 6767});
+        clients.back().set_option(tcp::no_delay(true));
+    }
+    std::vector<char> buf(1 << 20);
+    for (bool quiet = false; !quiet;) { // until the "has entered" broadcasts are through
+        std::this_thread::sleep_for(200ms);
+        quiet = true;
+        for (auto& c : clients) {
+            while (c.available()) {
+                c.read_some(ba::buffer(buf));
+                quiet = false;
+            }
+        }
+    }
+
+    std::string msg(63, 'b');
+    std::vector<double> lat;
+    auto syscalls0 = uring && srv.io_uring() ? srv.io_uring()->get_stats().syscalls : 0;
+    auto cpu0      = cpu_secs(io);
+    for (int i = 0; i < broadcasts; ++i) {
+        auto start = clk::now();
+        srv.broadcast(msg);
+        for (auto& c : clients)
+            ba::read(c, ba::buffer(buf.data(), msg.size() + 1));
+        lat.push_back(std::chrono::duration<double, std::micro>(clk::now() - start).count());
+    }
+    double cpu = cpu_secs(io) - cpu0;
+
+    std::sort(lat.begin(), lat.end());
+    std::printf("%5zu conns  %-8s last recipient p50 %8.1f us  p99 %8.1f us  io cpu %7.1f us/bcast", n,
+                uring ? "io_uring" : "asio", lat[lat.size() / 2], lat[lat.size() * 99 / 100],
+                cpu / broadcasts * 1e6);
+    if (auto e = srv.io_uring())
+        std::printf("  %.2f enter/bcast", double(e->get_stats().syscalls - syscalls0) / broadcasts);
+    std::printf("\n");
+
+    clients.clear(); // clients close first, no TIME_WAIT on the listening port
+    std::this_thread::sleep_for(100ms);
+    srv.stop();
+    ioc.stop();
+    io.join();
+}
+
+int main(int argc, char** argv) {
+    s_verbose = false;
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    if (argc > 1) { // just this many connections
+        for (bool uring : {false, true})
+            bench(std::stoul(argv[1]), uring);
+        return 0;
+    }
+    for (size_t n : {10, 100, 1000})
+        for (bool uring : {false, true})
+            bench(n, uring);
+}
@@ -0,0 +1,105 @@
+// Skewed per-connection load on three handler schedulers:
+//   sharded   one io_context per thread, connection i on context i % threads
+//   shared    one io_context run by all threads, a strand per connection
+//   stealing  work_stealing::pool, a strand per connection
+//
+// Every connection handles a chain of messages (each handler posts the next,
+// like a read completion starting the next read); the connections that hash
+// to shard 0 get `skew` times the messages of the rest. Reports wall time to
+// drain everything.
+//
+//  g++ -std=c++17 -O2 bench_work_stealing.cpp -o bench_work_stealing -pthread
+//  ./bench_work_stealing [threads] [skew]
+#include "work_stealing.hpp"
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+
+namespace ba = boost::asio;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t connections = 64;
+static constexpr size_t base_msgs   = 200;
+static constexpr auto   work        = std::chrono::microseconds(5);
+
+static void spin(std::chrono::microseconds d) {
+    for (auto until = clk::now() + d; clk::now() < until;)
+        ;
+}
+
+template <typename Executor> struct chain {
+    Executor              ex;
+    size_t                left;
+    std::atomic<size_t>&  remaining;
+    std::promise<void>&   done;
+
+    void operator()() {
+        spin(work);
+        if (--left)
+            return ba::post(ex, *this);
+        if (--remaining == 0)
+            done.set_value();
+    }
+};
+
+template <typename MakeExecutor> static double run(size_t threads, size_t skew, MakeExecutor make) {
+    std::atomic<size_t> remaining{connections};
+    std::promise<void>  done;
+
+    auto start = clk::now();
+    for (size_t i = 0; i < connections; ++i) {
+        size_t msgs = i % threads == 0 ? base_msgs * skew : base_msgs;
+        auto   ex   = make(i);
+        ba::post(ex, chain<decltype(ex)>{ex, msgs, remaining, done});
+    }
+    done.get_future().wait();
+    return std::chrono::duration<double, std::milli>(clk::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t threads = argc > 1 ? std::stoul(argv[1]) : 4;
+    size_t skew    = argc > 2 ? std::stoul(argv[2]) : 20;
+    size_t total   = connections * base_msgs + (connections + threads - 1) / threads * base_msgs * (skew - 1);
+    std::printf("%zu threads, %zu connections, 1/%zu of them %zux hot, %zu handlers of %lld us\n", threads,
+                connections, threads, skew, total, static_cast<long long>(work.count()));
+
+    { // sharded
+        std::vector<std::unique_ptr<ba::io_context>> ctx;
+        std::vector<std::thread> th;
+        for (size_t i = 0; i < threads; ++i)
+            ctx.push_back(std::make_unique<ba::io_context>(1));
+        std::vector<ba::executor_work_guard<ba::io_context::executor_type>> guards;
+        for (auto& c : ctx)
+            guards.push_back(make_work_guard(*c));
+        for (auto& c : ctx)
+            th.emplace_back([&c] { c->run(); });
+
+        auto ms = run(threads, skew, [&](size_t i) { return ctx[i % threads]->get_executor(); });
+        std::printf("sharded   %8.1f ms\n", ms);
+        guards.clear();
+        for (auto& t : th)
+            t.join();
+    }
+
+    { // shared
+        ba::io_context ioc;
+        auto guard = make_work_guard(ioc);
+        std::vector<std::thread> th;
+        for (size_t i = 0; i < threads; ++i)
+            th.emplace_back([&ioc] { ioc.run(); });
+
+        auto ms = run(threads, skew, [&](size_t) { return ba::make_strand(ioc); });
+        std::printf("shared    %8.1f ms\n", ms);
+        guard.reset();
+        for (auto& t : th)
+            t.join();
+    }
+
+    { // stealing
+        work_stealing::pool pool(threads);
+        auto ms = run(threads, skew, [&](size_t) { return ba::strand<work_stealing::pool::executor_type>(pool.get_executor()); });
+        auto st = pool.get_stats();
+        std::printf("stealing  %8.1f ms  (%zu of %zu handlers stolen)\n", ms, st.stolen, st.executed);
+    }
+}
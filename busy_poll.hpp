@@ -0,0 +1,57 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <sys/socket.h>
+#include <chrono>
+
+#ifndef SO_PREFER_BUSY_POLL // Linux 5.11 headers
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+// Busy-polling run mode, for threads that may burn their core for latency.
+//
+// run() keeps calling io_context::poll() (epoll_wait with a zero timeout)
+// and only blocks in run_one() once nothing has been ready for `spin`. A
+// handler that becomes ready during the spin runs without the sleep/wakeup
+// of a blocking epoll_wait.
+//
+// enable() additionally makes the kernel busy-poll the device queue on
+// blocking reads and epoll of that socket (SO_BUSY_POLL), preferring that
+// over interrupts (SO_PREFER_BUSY_POLL). Raising SO_BUSY_POLL above
+// net.core.busy_read needs CAP_NET_ADMIN; it is a no-op for AF_UNIX and
+// loopback, which have no device queue to poll.
+namespace busy_poll {
+    namespace ba = boost::asio;
+    using clk    = std::chrono::steady_clock;
+
+    inline bool enable(int fd, std::chrono::microseconds budget) {
+        int usecs = int(budget.count()), one = 1;
+        bool ok = ::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) == 0;
+        ::setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)); // best effort
+        return ok;
+    }
+
+    // like ioc.run(): returns once the io_context runs out of work or is stopped
+    inline size_t run(ba::io_context& ioc, std::chrono::microseconds spin) {
+        if (!spin.count())
+            return ioc.run();
+
+        size_t n = 0;
+        for (auto idle_since = clk::now();;) {
+            if (auto ran = ioc.poll()) {
+                n += ran;
+                idle_since = clk::now();
+                continue;
+            }
+            if (ioc.stopped())
+                return n;
+            if (clk::now() - idle_since < spin)
+                continue;
+
+            auto ran = ioc.run_one(); // give the core back until something happens
+            if (!ran)
+                return n;
+            n += ran;
+            idle_since = clk::now();
+        }
+    }
+}
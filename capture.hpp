@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Traffic capture: what the clients sent and what the server broadcast, with
+// timestamps, for the replay tool (replay.cpp) to reproduce against another
+// build.
+//
+// The file is "bcap" + version, then one record after the other:
+//
+//   kind:8  dt:varint  [conn:varint]  [size:varint bytes]
+//
+// dt is microseconds since the previous record, conn the connection's
+// number within the capture. Records are written in the order the calls
+// happen, from any thread.
+namespace capture {
+    static constexpr char    magic[4] = {'b', 'c', 'a', 'p'};
+    static constexpr uint8_t version  = 1;
+
+    enum class kind : uint8_t {
+        open = 1,  // conn
+        hello,     // conn, 1 byte: the hello byte, 0 for newline framing
+        rx,        // conn, a message the client sent (frame body or line)
+        close,     // conn
+        broadcast, // payload
+        state,     // payload (broadcast_state)
+    };
+
+    static constexpr bool has_conn(kind k) { return k <= kind::close; }
+    static constexpr bool has_payload(kind k) { return k == kind::hello || (k >= kind::rx && k != kind::close); }
+
+    struct record {
+        kind        what;
+        uint64_t    at_us; // since the start of the capture
+        uint64_t    conn = 0;
+        std::string payload;
+    };
+
+    struct writer {
+        explicit writer(std::string const& path) : _f(std::fopen(path.c_str(), "wb")) {
+            if (!_f)
+                throw std::system_error(errno, std::generic_category(), "capture: " + path);
+            std::setvbuf(_f, nullptr, _IOFBF, 1 << 20);
+            std::fwrite(magic, 1, sizeof(magic), _f);
+            std::fputc(version, _f);
+        }
+        ~writer() { std::fclose(_f); }
+        writer(writer const&) = delete;
+        writer& operator=(writer const&) = delete;
+
+        void open(uint64_t conn) { put(kind::open, conn, {}); }
+        void hello(uint64_t conn, uint8_t byte) { put(kind::hello, conn, {reinterpret_cast<char*>(&byte), 1}); }
+        void rx(uint64_t conn, std::string_view msg) { put(kind::rx, conn, msg); }
+        void close(uint64_t conn) { put(kind::close, conn, {}); }
+        void broadcast(std::string_view msg) { put(kind::broadcast, 0, msg); }
+        void state(std::string_view msg) { put(kind::state, 0, msg); }
+
+      private:
+        void put(kind k, uint64_t conn, std::string_view payload) {
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lk(_mx);
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - _start).count();
+            std::fputc(int(k), _f);
+            varint(std::max<int64_t>(us - _last_us, 0)); // clock read outside the lock
+            _last_us = std::max(us, _last_us);
+            if (has_conn(k))
+                varint(conn);
+            if (has_payload(k)) {
+                varint(payload.size());
+                std::fwrite(payload.data(), 1, payload.size(), _f);
+            }
+        }
+
+        void varint(uint64_t v) {
+            for (; v >= 0x80; v >>= 7)
+                std::fputc(int(v & 0x7f) | 0x80, _f);
+            std::fputc(int(v), _f);
+        }
+
+        std::mutex _mx;
+        std::FILE* _f;
+        std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+        int64_t _last_us = 0;
+    };
+
+    struct reader {
+        explicit reader(std::string const& path) : _f(std::fopen(path.c_str(), "rb")) {
+            if (!_f)
+                throw std::system_error(errno, std::generic_category(), "capture: " + path);
+            char m[sizeof(magic)];
+            if (std::fread(m, 1, sizeof(m), _f) != sizeof(m) || std::string_view(m, 4) != std::string_view(magic, 4) ||
+                std::fgetc(_f) != version) {
+                std::fclose(_f);
+                throw std::runtime_error("capture: not a version 1 capture: " + path);
+            }
+        }
+        ~reader() { std::fclose(_f); }
+        reader(reader const&) = delete;
+        reader& operator=(reader const&) = delete;
+
+        // false at the end (a truncated last record counts as the end)
+        bool next(record& r) {
+            int k = std::fgetc(_f);
+            uint64_t dt, size;
+            if (k == EOF || !varint(dt))
+                return false;
+            r.what = kind(k);
+            r.at_us = _at_us += dt;
+            r.conn  = 0;
+            r.payload.clear();
+            if (has_conn(r.what) && !varint(r.conn))
+                return false;
+            if (has_payload(r.what)) {
+                if (!varint(size))
+                    return false;
+                r.payload.resize(size);
+                if (std::fread(r.payload.data(), 1, size, _f) != size)
+                    return false;
+            }
+            return true;
+        }
+
+      private:
+        bool varint(uint64_t& v) {
+            v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                int b = std::fgetc(_f);
+                if (b == EOF)
+                    return false;
+                v |= uint64_t(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        std::FILE* _f;
+        uint64_t   _at_us = 0;
+    };
+}
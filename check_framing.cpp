@@ -0,0 +1,353 @@
+// Checks of the wire contracts, against the server over in-memory clients
+// (loopback.hpp); prints what failed and exits non-zero.
+//
+//  - a client that never sends a byte still gets its broadcasts, as lines,
+//    once the hello window has passed (framing::mode::detect); a hello
+//    that comes after that closes the connection
+//  - what was queued before a deflate-capable client's hello goes out
+//    deflated, and inflates to what was broadcast
+//  - broadcasts held back until framing is known keep their order, and so
+//    do those queued while a connection moves to another shard (over TCP,
+//    the one thing here that needs a real socket)
+//  - deflate, frame, unframe, inflate round-trips, and does so only with the
+//    preset dictionary
+//  - a file broadcast reaches a length-prefixed client whole, and a line
+//    client not at all, with what follows it unharmed; a file that shrinks
+//    once its size is on the wire closes the connection instead of stalling it
+//
+//  g++ -std=c++17 -O2 check_framing.cpp -o check_framing -pthread -lz && ./check_framing
+#include "server.hpp"
+#include <cstdio>
+#include <future>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static int s_failed = 0;
+
+static void check(bool ok, char const* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    s_failed += !ok;
+}
+
+template <typename F> static auto within(std::future<F>& f) { return f.wait_for(2s) == std::future_status::ready; }
+
+struct harness {
+    explicit harness(server_options opts) : srv(ioc, opts) {}
+    ~harness() {
+        srv.stop();
+        ioc.stop();
+        io.join();
+    }
+
+    template <typename F> auto on_io(F f) { return ba::post(ioc, ba::use_future(std::move(f))).get(); }
+
+    ba::io_context ioc;
+    server         srv;
+    std::thread    io{[this] {
+        auto work = make_work_guard(ioc);
+        ioc.run();
+    }};
+};
+
+static std::vector<std::string> read_lines(loopback::stream& s, size_t n) {
+    ba::streambuf rx;
+    std::vector<std::string> lines;
+    while (lines.size() < n) {
+        auto f = ba::async_read_until(s, rx, "\n", ba::use_future);
+        if (!within(f))
+            break;
+        std::string line(ba::buffers_begin(rx.data()), ba::buffers_begin(rx.data()) + f.get() - 1);
+        rx.consume(line.size() + 1);
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+static std::optional<std::pair<framing::header, std::string>> read_frame(loopback::stream& s) {
+    framing::header::bytes hdr;
+    auto f = ba::async_read(s, ba::buffer(hdr), ba::use_future);
+    if (!within(f))
+        return {};
+    auto h = framing::header::decode(hdr.data());
+    std::string body(h.size, '\0');
+    auto g = ba::async_read(s, ba::buffer(body), ba::use_future);
+    if (!within(g))
+        return {};
+    return std::pair{h, std::move(body)};
+}
+
+static void silent_client() {
+    server_options opts; // detect
+    harness h(opts);
+    auto client = h.srv.connect_loopback();
+
+    std::this_thread::sleep_for(opts.hello_window + 100ms);
+    h.on_io([&] { return h.srv.broadcast("random global event broadcast"); });
+
+    auto lines = read_lines(client, 2);
+    check(lines.size() == 2, "silent client: gets lines without sending anything");
+    check(lines.size() == 2 && lines[0] == "player #1 has entered the game" &&
+              lines[1] == "random global event broadcast",
+          "silent client: the join, then the broadcast");
+}
+
+static void late_hello() {
+    server_options opts; // detect
+    harness h(opts);
+    auto client = h.srv.connect_loopback();
+    std::this_thread::sleep_for(opts.hello_window + 100ms); // newline by now
+
+    uint8_t hello = framing::hello_magic;
+    ba::async_write(client, ba::buffer(&hello, 1), ba::use_future).get();
+    ba::streambuf rx;
+    auto f = ba::async_read(client, rx, ba::use_future); // to the end
+    bool closed = false;
+    if (within(f)) {
+        try {
+            f.get();
+        } catch (boost::system::system_error const& e) {
+            closed = e.code() == ba::error::eof;
+        }
+    }
+    check(closed, "hello after the hello window: closed, not read as a line");
+}
+
+static void deflate_before_hello() {
+    server_options opts; // detect
+    opts.compress = true;
+    harness h(opts);
+    auto client = h.srv.connect_loopback();
+
+    std::string msg;
+    for (int i = 0; i < 20; ++i)
+        msg += "{\"type\":\"update\",\"id\":" + std::to_string(i) + ",\"pos\":[1,2]}";
+    h.on_io([&] { return h.srv.broadcast(msg); });
+    std::this_thread::sleep_for(50ms); // queued on the connection, framing still unknown
+
+    uint8_t hello = framing::hello_magic | framing::cap_deflate;
+    ba::async_write(client, ba::buffer(&hello, 1), ba::use_future).get();
+
+    auto join = read_frame(client), bcast = read_frame(client);
+    check(join && bcast && !(join->first.flags & framing::flag_deflate) && join->second == "player #1 has entered the game",
+          "queued before the hello: the join first");
+    bool deflated = bcast && bcast->first.flags & framing::flag_deflate;
+    check(deflated, "queued before the hello: deflated for a cap_deflate client");
+    check(deflated && compression::inflate(bcast->second) == msg, "queued before the hello: inflates to the broadcast");
+}
+
+static void held_in_order() {
+    server_options opts; // detect
+    harness h(opts);
+    auto client = h.srv.connect_loopback();
+    for (auto m : {"first", "second", "third"}) // held until the hello window passes
+        h.on_io([&] { return h.srv.broadcast(m); });
+
+    auto lines = read_lines(client, 4);
+    check(lines == std::vector<std::string>{"player #1 has entered the game", "first", "second", "third"},
+          "held before framing is known: broadcasts in the order they were made");
+}
+
+static void file_shrinks() {
+    char path[] = "/tmp/check_framingXXXXXX";
+    int fd = ::mkstemp(path);
+    std::string contents(1 << 20, 'f');
+    check(fd >= 0 && ::write(fd, contents.data(), contents.size()) == ssize_t(contents.size()), "file: written");
+
+    server_options opts;
+    opts.framing = framing::mode::length_prefixed;
+    harness h(opts);
+    auto client = h.srv.connect_loopback(); // doesn't read yet: the file goes out a slice at a time
+    uint8_t hello = framing::hello_magic;
+    ba::async_write(client, ba::buffer(&hello, 1), ba::use_future).get();
+    std::this_thread::sleep_for(50ms);
+
+    h.on_io([&] { return h.srv.broadcast_file(path); });
+    std::this_thread::sleep_for(50ms);
+    check(::ftruncate(fd, 0) == 0, "file: truncated while it is being sent");
+    ::close(fd);
+    ::unlink(path);
+
+    size_t got = 0;
+    std::vector<char> buf(64 << 10);
+    error_code ec;
+    while (!ec) {
+        auto f = client.async_read_some(ba::buffer(buf), ba::use_future);
+        if (!within(f))
+            break;
+        try {
+            got += f.get();
+        } catch (boost::system::system_error const& e) {
+            ec = e.code();
+        }
+    }
+    check(ec == ba::error::eof && got < contents.size(), "file: shrunk after its header went out, the connection closes");
+}
+
+static void file_to_line_client() {
+    char path[] = "/tmp/check_framingXXXXXX";
+    int fd = ::mkstemp(path);
+    std::string contents = "two\nlines\n";
+    check(fd >= 0 && ::write(fd, contents.data(), contents.size()) == ssize_t(contents.size()), "file: written");
+    ::close(fd);
+
+    server_options opts; // detect
+    harness h(opts);
+    auto lines  = h.srv.connect_loopback();
+    auto framed = h.srv.connect_loopback();
+    uint8_t hello = framing::hello_magic;
+    ba::async_write(lines, ba::buffer("hi\n", 3), ba::use_future).get();
+    ba::async_write(framed, ba::buffer(&hello, 1), ba::use_future).get();
+    std::this_thread::sleep_for(50ms);
+
+    h.on_io([&] { return h.srv.broadcast_file(path); });
+    h.on_io([&] { return h.srv.broadcast("after the file"); });
+    ::unlink(path);
+
+    auto got = read_lines(lines, 4); // both joins, the echo, the broadcast
+    check(got.size() == 4 && got[3] == "after the file", "file: not sent to a line client, what follows is");
+
+    std::string file, after;
+    while (auto frame = read_frame(framed)) {
+        if (frame->second == contents)
+            file = frame->second;
+        else if (frame->second == "after the file")
+            after = frame->second;
+        if (!after.empty())
+            break;
+    }
+    check(file == contents && !after.empty(), "file: whole to a length-prefixed client, in order");
+}
+
+// blocking, for the TCP clients
+static std::string read_line(tcp::socket& s, ba::streambuf& rx) {
+    auto n = ba::read_until(s, rx, "\n");
+    std::string line(ba::buffers_begin(rx.data()), ba::buffers_begin(rx.data()) + n - 1);
+    rx.consume(n);
+    return line;
+}
+
+static void echo(tcp::socket& s, ba::streambuf& rx, size_t lines, size_t size) {
+    std::string line(size, 'e');
+    line += '\n';
+    for (size_t i = 0; i < lines; ++i) {
+        ba::write(s, ba::buffer(line));
+        while (read_line(s, rx)[0] != 'e') {} // the joins come in between
+    }
+}
+
+static void urgent_across_migration() {
+    ba::io_context shard_a, shard_b;
+    auto work_a = make_work_guard(shard_a), work_b = make_work_guard(shard_b);
+    std::thread run_a([&] { shard_a.run(); }), run_b([&] { shard_b.run(); });
+
+    server_options opts;
+    opts.framing   = framing::mode::newline;
+    opts.shards    = {&shard_a, &shard_b};
+    opts.rebalance = 1h; // meters the handlers; the rebalancing is done here
+    bool moved = false;
+    std::vector<std::string> got;
+    {
+        harness h(opts);
+        ba::io_context cio;
+        std::vector<tcp::socket> c;
+        std::vector<ba::streambuf> rx(3);
+        for (int i = 0; i < 3; ++i) // round robin: c[0] and c[2] on a, c[1] on b
+            c.emplace_back(cio).connect({ba::ip::address_v4::loopback(), 6767});
+
+        // a is the busier shard by far, and c[2], whose echo is stuck in its
+        // socket, the connection that evens it out best (see rebalance)
+        echo(c[0], rx[0], 40, 1 << 20);
+        echo(c[1], rx[1], 4, 1 << 20);
+        ba::write(c[2], ba::buffer(std::string(32 << 20, 'e') + '\n'));
+        std::this_thread::sleep_for(300ms);
+
+        moved = h.on_io([&] { return h.srv.rebalance(); }); // waits for the echo, then parks
+        for (int i = 0; i < 5; ++i)
+            h.on_io([&] { return h.srv.broadcast("u" + std::to_string(i)); });
+
+        std::atomic<bool> drained{false};
+        std::thread others([&] { // keep reading what everyone gets
+            for (int i : {0, 1})
+                while (read_line(c[i], rx[i]) != "end") {}
+            drained = true;
+        });
+        std::thread mover([&] {
+            while (read_line(c[2], rx[2])[0] != 'e') {} // the joins, up to the echo
+            for (std::string line; (line = read_line(c[2], rx[2])) != "end";)
+                got.push_back(line.substr(0, 1) == "u" ? line : "?" + line);
+        });
+        for (int i = 5; i < 200; ++i) { // some while the connection is parked
+            h.on_io([&] { return h.srv.broadcast("u" + std::to_string(i)); });
+            std::this_thread::sleep_for(100us);
+        }
+        h.on_io([&] { return h.srv.broadcast("end"); });
+        mover.join();
+        others.join();
+    }
+    shard_a.stop();
+    shard_b.stop();
+    run_a.join();
+    run_b.join();
+
+    std::vector<std::string> want;
+    for (int i = 0; i < 200; ++i)
+        want.push_back("u" + std::to_string(i));
+    check(moved, "migration: the connection moved");
+    check(got == want, "migration: queued at_front before and while parked, in order");
+}
+
+static bool inflates_without_dictionary(std::string_view data) {
+    z_stream zs{};
+    inflateInit2(&zs, -15);
+    std::string out(1 << 16, '\0');
+    zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in  = data.size();
+    zs.next_out  = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    int rc = ::inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+static void round_trip() {
+    std::string phrases, text, binary;
+    for (int i = 0; i < 8; ++i)
+        phrases += "player #" + std::to_string(i) + " has entered the game random global event broadcast ";
+    for (int i = 0; i < 50; ++i)
+        text += "the quick brown fox jumps over the lazy dog " + std::to_string(i * i) + "\n";
+    for (int i = 0; i < 4096; ++i)
+        binary += char(i * 7 + (i >> 3));
+
+    bool all = true;
+    for (auto& msg : {phrases, text, binary}) {
+        auto z = compression::deflate(msg);
+        if (z.empty())
+            continue; // sent raw
+        auto framed = framing::header{framing::flag_deflate, uint32_t(z.size())}.encode();
+        std::string wire(framed.begin(), framed.end());
+        wire += z;
+
+        auto h = framing::header::decode(reinterpret_cast<uint8_t const*>(wire.data()));
+        all &= h.flags == framing::flag_deflate && h.size == wire.size() - framing::header_size &&
+               compression::inflate(std::string_view(wire).substr(framing::header_size)) == msg;
+    }
+    check(all, "deflate, frame, unframe, inflate");
+    check(compression::deflate(std::string(100, 'x')).empty(), "below min_size: not deflated");
+
+    auto z = compression::deflate(phrases);
+    check(!z.empty() && !inflates_without_dictionary(z), "raw deflate: needs the preset dictionary to inflate");
+}
+
+int main() {
+    std::cout.setstate(std::ios::failbit); // the server's accept logging
+    silent_client();
+    late_hello();
+    deflate_before_hello();
+    held_in_order();
+    urgent_across_migration();
+    file_to_line_client();
+    file_shrinks();
+    round_trip();
+    return s_failed ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <zlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Stateless raw-deflate with a preset dictionary (link with -lz).
+//
+// Every message is compressed independently, so a broadcast is compressed once
+// and the result can be shared by all subscribers, regardless of what else
+// they received before. The dictionary primes the window with the phrases our
+// broadcasts are made of; clients must inflate with the very same bytes.
+namespace compression {
+    static constexpr size_t min_size = 128; // below this, deflate rarely pays off
+
+    inline std::string_view dictionary() {
+        static constexpr char dict[] =
+            "random global event broadcast"
+            " has left the game has entered the game player #"
+            "\"type\":\"update\",\"id\":\"name\":\"pos\":[\"roster\":[\"map\":";
+        return {dict, sizeof(dict) - 1};
+    }
+
+    // returns empty if compression doesn't make the message smaller
+    inline std::string deflate(std::string_view msg) {
+        if (msg.size() < min_size)
+            return {};
+
+        z_stream zs{};
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("deflateInit2");
+
+        auto dict = dictionary();
+        deflateSetDictionary(&zs, reinterpret_cast<Bytef const*>(dict.data()), dict.size());
+
+        std::string out(deflateBound(&zs, msg.size()), '\0');
+        zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(msg.data()));
+        zs.avail_in  = msg.size();
+        zs.next_out  = reinterpret_cast<Bytef*>(&out[0]);
+        zs.avail_out = out.size();
+
+        int rc = ::deflate(&zs, Z_FINISH);
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END)
+            throw std::runtime_error("deflate");
+
+        out.resize(zs.total_out);
+        if (out.size() >= msg.size())
+            out.clear();
+        return out;
+    }
+
+    inline std::string inflate(std::string_view data, size_t max_size = 16u << 20) {
+        z_stream zs{};
+        if (inflateInit2(&zs, -15) != Z_OK)
+            throw std::runtime_error("inflateInit2");
+
+        auto dict = dictionary();
+        inflateSetDictionary(&zs, reinterpret_cast<Bytef const*>(dict.data()), dict.size());
+
+        std::string out;
+        zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        zs.avail_in = data.size();
+
+        int rc = Z_OK;
+        while (rc == Z_OK) {
+            if (out.size() >= max_size)
+                break;
+            size_t have = out.size();
+            out.resize(std::min(max_size, std::max<size_t>(2 * have, 4 * data.size())));
+            zs.next_out  = reinterpret_cast<Bytef*>(&out[have]);
+            zs.avail_out = out.size() - have;
+            rc = ::inflate(&zs, Z_NO_FLUSH);
+        }
+        inflateEnd(&zs);
+        if (rc != Z_STREAM_END)
+            throw std::runtime_error("inflate");
+
+        out.resize(zs.total_out);
+        return out;
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <boost/system/error_code.hpp>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Just enough C++20 coroutine machinery for the connection loops (see
+// BROADCAST_COROUTINES in server.hpp), without Asio's awaitable, which
+// allocates a frame per co_await'ed operation.
+//
+// A coro::loop is started by calling it and runs until its first co_await;
+// it is owned by whichever completion handler will resume it. When the
+// handler is destroyed without being called (the io_context went away), so is
+// the coroutine, and whatever its frame holds - typically the connection.
+//
+// Frames come from a per-thread recycling pool: a burst of writes costs one
+// frame, and that is the one the previous burst gave back.
+namespace coro {
+    // per thread free lists in 64 byte size classes up to 2 KiB
+    struct frame_pool {
+        static constexpr size_t granule = 64, classes = 32, max_free = 256;
+
+        struct stats {
+            size_t fresh = 0, recycled = 0;
+        };
+
+        static void* allocate(size_t size) {
+            auto& p = local();
+            auto  c = size_class(size);
+            if (c < classes && !p.free[c].empty()) {
+                ++p.counts.recycled;
+                auto block = p.free[c].back();
+                p.free[c].pop_back();
+                return block;
+            }
+            ++p.counts.fresh;
+            return ::operator new(c < classes ? (c + 1) * granule : size);
+        }
+
+        static void deallocate(void* block, size_t size) { // possibly on another thread than allocate()
+            auto& p = local();
+            auto  c = size_class(size);
+            if (c < classes && p.free[c].size() < max_free)
+                return p.free[c].push_back(block);
+            ::operator delete(block);
+        }
+
+        static stats get_stats() { return local().counts; } // this thread's
+
+      private:
+        static size_t size_class(size_t size) { return (size - 1) / granule; }
+
+        struct lists {
+            std::array<std::vector<void*>, classes> free;
+            stats                                   counts;
+            ~lists() {
+                for (auto& l : free)
+                    for (auto block : l)
+                        ::operator delete(block);
+            }
+        };
+        static lists& local() {
+            thread_local lists p;
+            return p;
+        }
+    };
+
+    struct loop {
+        struct promise_type {
+            loop                get_return_object() { return {}; }
+            std::suspend_never  initial_suspend() noexcept { return {}; }
+            std::suspend_never  final_suspend() noexcept { return {}; }
+            void                return_void() {}
+            void                unhandled_exception() { std::terminate(); }
+
+            static void* operator new(size_t size) { return frame_pool::allocate(size); }
+            static void  operator delete(void* p, size_t size) { frame_pool::deallocate(p, size); }
+        };
+    };
+
+    using error_code = boost::system::error_code;
+
+    struct result {
+        error_code ec;
+        size_t     n = 0;
+    };
+
+    // the completion handler: resumes the coroutine, or destroys it unresumed
+    struct resumer {
+        resumer(std::coroutine_handle<> h, result* r) : _h(h), _r(r) {}
+        resumer(resumer&& other) noexcept : _h(std::exchange(other._h, {})), _r(other._r) {}
+        resumer& operator=(resumer&&) = delete;
+        ~resumer() {
+            if (_h)
+                _h.destroy();
+        }
+
+        void operator()(error_code ec, size_t n = 0) {
+            _r->ec = ec;
+            _r->n  = n;
+            std::exchange(_h, {}).resume();
+        }
+
+      private:
+        std::coroutine_handle<> _h;
+        result*                 _r;
+    };
+
+    // co_await coro::async([&](auto handler) { ba::async_write(s, bufs, std::move(handler)); })
+    template <typename Initiate> struct op {
+        Initiate _init;
+        result   _result;
+
+        bool   await_ready() const noexcept { return false; }
+        void   await_suspend(std::coroutine_handle<> h) { _init(resumer(h, &_result)); }
+        result await_resume() { return _result; }
+    };
+
+    template <typename Initiate> op<Initiate> async(Initiate init) { return {std::move(init), {}}; }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// Multi-message envelopes: many small messages packed into the body of a
+// single length-prefixed frame (flag_envelope), each preceded by a varint
+// (LEB128) entry header:
+//
+//      entry := varint(size << 1 | deflated) bytes[size]
+//
+// Most entries pay 1 or 2 bytes of framing instead of a 5-byte frame header,
+// and a whole batch goes out in one write (one segment, one client read).
+namespace envelope {
+    static constexpr size_t max_entry   = 1024; // larger messages get a frame of their own
+    static constexpr size_t max_count   = 64;   // entries per envelope
+    static constexpr size_t max_varint  = 10;
+
+    inline size_t put_varint(uint8_t* out, uint64_t v) {
+        size_t n = 0;
+        for (; v >= 0x80; v >>= 7)
+            out[n++] = uint8_t(v) | 0x80;
+        out[n++] = uint8_t(v);
+        return n;
+    }
+
+    inline bool get_varint(uint8_t const*& p, uint8_t const* end, uint64_t& v) {
+        v = 0;
+        for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    inline size_t varint_size(uint64_t v) {
+        size_t n = 1;
+        while (v >>= 7)
+            ++n;
+        return n;
+    }
+
+    inline uint64_t entry_tag(size_t size, bool deflated) { return uint64_t(size) << 1 | deflated; }
+
+    // calls f(std::string_view entry, bool deflated) for each entry; false if malformed
+    template <typename F> bool unpack(std::string_view body, F f) {
+        auto p   = reinterpret_cast<uint8_t const*>(body.data());
+        auto end = p + body.size();
+        while (p != end) {
+            uint64_t tag;
+            if (!get_varint(p, end, tag) || (tag >> 1) > uint64_t(end - p))
+                return false;
+            f(std::string_view(reinterpret_cast<char const*>(p), tag >> 1), bool(tag & 1));
+            p += tag >> 1;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "framing.hpp"
+
+// A byte stream as a broadcast source: stdin, a pipe/FIFO or a file.
+// Opening never blocks: a FIFO without a writer is polled until one shows
+// up, and the feed ends when the writer it got closes.
+//
+// Files (including stdin redirected from one) are mmap'd and walked a chunk
+// at a time; anything else is read with large async reads. Either way the
+// stream is split into messages with the connections' framing - lines, or
+// 5-byte headers after a hello byte - and handed to the sink a batch per
+// chunk. Between chunks the source checks `busy`, so a slow audience holds
+// back the feed rather than queueing the whole file in memory.
+namespace feed {
+    namespace ba = boost::asio;
+
+    using batch = std::vector<std::string>;
+
+    struct stats {
+        uint64_t bytes = 0, messages = 0, batches = 0, stalls = 0, malformed = 0;
+    };
+
+    // framing::mode::detect decides on the first byte, like a connection does
+    struct splitter {
+        explicit splitter(framing::mode m) : _mode(m) {}
+
+        // appends the complete messages in `data` to `out`, keeps the rest
+        void feed(std::string_view data, batch& out, stats& st) {
+            if (_mode == framing::mode::detect && !data.empty()) {
+                _mode = framing::is_hello(uint8_t(data[0])) ? framing::mode::length_prefixed : framing::mode::newline;
+                if (_mode == framing::mode::length_prefixed)
+                    data.remove_prefix(1);
+            }
+            if (_broken || !complete(data, out, st))
+                return;
+
+            if (_mode == framing::mode::length_prefixed) {
+                while (data.size() >= framing::header_size) {
+                    auto size = body_size(data.data(), st);
+                    if (_broken)
+                        return;
+                    if (data.size() < framing::header_size + size)
+                        break;
+                    out.emplace_back(data.substr(framing::header_size, size));
+                    ++st.messages;
+                    data.remove_prefix(framing::header_size + size);
+                }
+            } else {
+                for (size_t nl; (nl = data.find('\n')) != std::string_view::npos;) {
+                    out.emplace_back(data.substr(0, nl));
+                    ++st.messages;
+                    data.remove_prefix(nl + 1);
+                }
+            }
+            _partial.assign(data);
+        }
+
+        // the unterminated last line, if any
+        void finish(batch& out, stats& st) {
+            if (_mode != framing::mode::length_prefixed && !_partial.empty()) {
+                out.push_back(std::move(_partial));
+                ++st.messages;
+            } else if (!_partial.empty()) {
+                ++st.malformed; // truncated frame
+            }
+            _partial.clear();
+        }
+
+      private:
+        // the message that straddles chunks; false if `data` didn't finish it
+        bool complete(std::string_view& data, batch& out, stats& st) {
+            if (_partial.empty())
+                return true;
+            size_t take;
+            if (_mode == framing::mode::length_prefixed) {
+                if (_partial.size() < framing::header_size) {
+                    take = std::min(framing::header_size - _partial.size(), data.size());
+                    _partial.append(data.substr(0, take));
+                    data.remove_prefix(take);
+                    if (_partial.size() < framing::header_size)
+                        return false;
+                }
+                auto size = body_size(_partial.data(), st);
+                if (_broken)
+                    return false;
+                take = std::min(framing::header_size + size - _partial.size(), data.size());
+                _partial.append(data.substr(0, take));
+                data.remove_prefix(take);
+                if (_partial.size() < framing::header_size + size)
+                    return false;
+                _partial.erase(0, framing::header_size);
+            } else {
+                auto nl = data.find('\n');
+                take    = nl == std::string_view::npos ? data.size() : nl;
+                _partial.append(data.substr(0, take));
+                data.remove_prefix(std::min(data.size(), take + 1));
+                if (nl == std::string_view::npos)
+                    return false;
+            }
+            out.push_back(std::move(_partial));
+            ++st.messages;
+            _partial.clear();
+            return true;
+        }
+
+        size_t body_size(char const* header, stats& st) {
+            auto h = framing::header::decode(reinterpret_cast<uint8_t const*>(header));
+            if (h.size > framing::max_body) { // out of sync, nothing sensible follows
+                ++st.malformed;
+                _broken = true;
+            }
+            return h.size;
+        }
+
+        framing::mode _mode;
+        std::string   _partial;
+        bool          _broken = false;
+    };
+
+    struct source {
+        using sink_fn = std::function<void(batch)>;
+        using busy_fn = std::function<bool()>;
+
+        static constexpr size_t chunk = 1 << 20;
+
+        // path "-" is stdin; throws std::system_error if it can't be opened
+        source(ba::io_context& ioc, std::string const& path, framing::mode mode, sink_fn sink, busy_fn busy = {})
+            : _split(mode), _sink(std::move(sink)), _busy(std::move(busy)), _pipe(ioc), _backoff(ioc) {
+            int fd = path == "-" ? ::dup(STDIN_FILENO) : ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "feed: " + path);
+
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                _size = st.st_size;
+                if (_size) {
+                    _map = static_cast<char const*>(::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0));
+                    int e = errno;
+                    ::close(fd);
+                    if (_map == MAP_FAILED)
+                        throw std::system_error(e, std::generic_category(), "feed: mmap " + path);
+                    ::madvise(const_cast<char*>(_map), _size, MADV_SEQUENTIAL);
+                } else {
+                    ::close(fd);
+                }
+            } else {
+                _fifo = path != "-" && S_ISFIFO(st.st_mode);
+                _pipe.assign(fd);
+                _pipe.non_blocking(true);
+                _buf.resize(chunk);
+            }
+        }
+
+        ~source() {
+            if (_map)
+                ::munmap(const_cast<char*>(_map), _size);
+        }
+        source(source const&) = delete;
+        source& operator=(source const&) = delete;
+
+        // runs on the io_context until the end of the stream or stop()
+        void start(std::function<void(stats const&)> on_done = {}) {
+            _on_done = std::move(on_done);
+            post(_backoff.get_executor(), [this] { step(); });
+        }
+
+        void stop() {
+            post(_backoff.get_executor(), [this] {
+                    _stopped = true;
+                    _backoff.cancel();
+                    error_code ec;
+                    _pipe.close(ec);
+                });
+        }
+
+        stats const& get_stats() const { return _stats; }
+
+      private:
+        using error_code = boost::system::error_code;
+
+        void step() {
+            if (_stopped)
+                return;
+            if (_busy && _busy()) { // let the audience catch up
+                ++_stats.stalls;
+                return step_after(std::chrono::milliseconds(1));
+            }
+
+            if (_pipe.is_open()) {
+                _pipe.async_read_some(ba::buffer(_buf), [this](error_code ec, size_t n) {
+                        consume({_buf.data(), n});
+                        if (ec == ba::error::eof && _fifo && !_stats.bytes) // no writer yet
+                            return step_after(std::chrono::milliseconds(50));
+                        if (ec)
+                            return done();
+                        step();
+                    });
+                return;
+            }
+
+            if (_offset < _size) { // a chunk per handler, other work runs in between
+                auto n = std::min(chunk, _size - _offset);
+                if (_offset + n < _size) // readahead of the next chunk, while this one is split
+                    ::madvise(const_cast<char*>(_map) + _offset + n, std::min(chunk, _size - _offset - n), MADV_WILLNEED);
+                consume({_map + _offset, n});
+                _offset += n;
+                if (auto consumed = _offset & ~size_t(4095); consumed > _dropped) { // copied out, unmap
+                    ::madvise(const_cast<char*>(_map) + _dropped, consumed - _dropped, MADV_DONTNEED);
+                    _dropped = consumed;
+                }
+                post(_backoff.get_executor(), [this] { step(); });
+                return;
+            }
+            done();
+        }
+
+        void step_after(std::chrono::milliseconds delay) {
+            _backoff.expires_after(delay);
+            _backoff.async_wait([this](error_code ec) {
+                    if (!ec) step();
+                });
+        }
+
+        void consume(std::string_view data) {
+            if (data.empty())
+                return;
+            _stats.bytes += data.size();
+            batch b;
+            _split.feed(data, b, _stats);
+            deliver(std::move(b));
+        }
+
+        void deliver(batch b) {
+            if (b.empty())
+                return;
+            ++_stats.batches;
+            _sink(std::move(b));
+        }
+
+        void done() {
+            if (_finished)
+                return;
+            _finished = true;
+            batch b;
+            _split.finish(b, _stats);
+            deliver(std::move(b));
+            if (_on_done)
+                _on_done(_stats);
+        }
+
+        splitter    _split;
+        sink_fn     _sink;
+        busy_fn     _busy;
+        std::function<void(stats const&)> _on_done;
+        stats       _stats;
+
+        char const* _map = nullptr; // regular files
+        size_t      _size = 0, _offset = 0, _dropped = 0;
+
+        ba::posix::stream_descriptor _pipe; // anything else
+        std::vector<char>            _buf;
+        bool                         _fifo = false; // named: EOF before any data means no writer yet
+
+        ba::steady_timer _backoff;
+        bool             _stopped = false, _finished = false;
+    };
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+
+// File-backed payloads (Linux): one open descriptor shared by every recipient,
+// sent with sendfile(2) straight from the page cache, so large assets never
+// have to be loaded into userspace memory.
+namespace file_payload {
+    struct file {
+        explicit file(int fd) : _fd(fd) {}
+        ~file() { ::close(_fd); }
+        file(file const&) = delete;
+        file& operator=(file const&) = delete;
+
+        int fd() const { return _fd; }
+
+      private:
+        int _fd;
+    };
+
+    struct region {
+        std::shared_ptr<file const> f;
+        uint64_t offset = 0;
+        uint64_t size   = 0;
+    };
+
+    inline std::shared_ptr<region const> open(std::string const& path) { // the whole file
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        auto f = std::make_shared<file const>(fd);
+
+        struct stat st;
+        if (::fstat(fd, &st))
+            throw std::system_error(errno, std::generic_category(), "fstat " + path);
+        return std::make_shared<region const>(region{f, 0, uint64_t(st.st_size)});
+    }
+
+    // sends as much of [sent, end) as the socket takes without blocking;
+    // returns 0 when complete, EAGAIN to wait for writability, else an errno
+    inline int send(int sock, region const& r, uint64_t& sent, uint64_t end) {
+        while (sent < end) {
+            off_t off = r.offset + sent;
+            auto  n   = ::sendfile(sock, r.f->fd(), &off, end - sent);
+            if (n > 0)
+                sent += n;
+            else if (n == 0)
+                return ENODATA; // file shrunk underneath us
+            else if (errno != EINTR)
+                return errno == EWOULDBLOCK ? EAGAIN : errno;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Wire framing shared by the server, the tools and the benchmarks.
+//
+//  - newline: each message is terminated by '\n' (payloads can't contain one)
+//  - length_prefixed: each message is preceded by a fixed 5-byte header
+//
+// Binary clients announce themselves with a single "hello" byte before the
+// first frame. The high nibble is the magic, the low nibble carries capability
+// bits. 0xB0..0xBF never starts a valid UTF-8 text line, which is what makes
+// per-connection detection unambiguous. A client that sends nothing for the
+// server's hello window (a listener like nc) gets newline framing.
+namespace framing {
+    enum class mode { newline, length_prefixed, detect };
+
+    static constexpr uint8_t hello_magic = 0xB0;
+    static constexpr uint8_t hello_mask  = 0xF0;
+
+    static constexpr bool is_hello(uint8_t b) { return (b & hello_mask) == hello_magic; }
+    static constexpr uint8_t capabilities(uint8_t hello) { return hello & ~hello_mask; }
+
+    // capability bits (hello low nibble)
+    static constexpr uint8_t cap_deflate  = 0x01; // accepts flag_deflate frames
+    static constexpr uint8_t cap_envelope = 0x02; // accepts flag_envelope frames
+
+    // header flags
+    static constexpr uint8_t flag_deflate  = 0x01; // body is compression::deflate'd
+    static constexpr uint8_t flag_envelope = 0x02; // body is a batch of envelope entries
+    static constexpr uint8_t flag_repair   = 0x04; // body is seq:64 + a missed multicast payload
+    static constexpr uint8_t flag_chunk    = 0x08; // body is a slice of a larger message
+    static constexpr uint8_t flag_more     = 0x10; // ... and more slices follow
+
+    // Messages larger than max_chunk go out as flag_chunk frames, all but the
+    // last with flag_more; the other flags are the message's own. Complete
+    // frames (no flag_chunk) may arrive between slices, never another chunked
+    // message, so a receiver needs just one reassembly buffer.
+    static constexpr uint32_t max_chunk = 64u << 10;
+
+    static constexpr size_t   header_size = 5;        // flags:8, size:32 big-endian
+    static constexpr uint32_t max_body    = 16u << 20; // sanity limit on inbound frames
+
+    struct header {
+        uint8_t  flags = 0;
+        uint32_t size  = 0;
+
+        using bytes = std::array<uint8_t, header_size>;
+
+        bytes encode() const {
+            return {{flags,
+                     uint8_t(size >> 24), uint8_t(size >> 16),
+                     uint8_t(size >> 8),  uint8_t(size)}};
+        }
+
+        static header decode(uint8_t const* p) {
+            return {p[0], uint32_t(p[1]) << 24 | uint32_t(p[2]) << 16 |
+                              uint32_t(p[3]) << 8 | uint32_t(p[4])};
+        }
+    };
+}
@@ -0,0 +1,323 @@
+// Impairment proxy: sits between clients and the server on this host and
+// makes the server's side of each connection look like a poor network, so
+// the server's queueing behind slow consumers can be measured reproducibly.
+//
+// What the server sends is delayed (latency plus uniform jitter, order
+// kept), paced to a bandwidth cap, and now and then stalled altogether. The
+// proxy buffers at most -q bytes per connection and stops reading from the
+// server beyond that, so the server sees backpressure, not a bottomless
+// sink. Client to server is forwarded as is, unless -U.
+//
+// Every option takes a comma-separated list, dealt round-robin to the
+// connections: -b 10M,100K makes every second connection a slow one. Runs
+// with the same -S seed impair the same way.
+//
+//  g++ -std=c++17 -O2 impair.cpp -o impair -pthread
+//  ./test & ./impair -b 1M,50K -d 20 -j 10 -s 2000:500 &   # clients connect to port 6769
+//
+//  -l port       listen here (6769)             -H host -p port  the server (127.0.0.1 6767)
+//  -b rate       bytes/s, K/M/G suffixes, 0: uncapped
+//  -d ms -j ms   latency, plus up to this much jitter
+//  -s every:for  a stall of `for` ms, on average every `every` ms (exponentially distributed)
+//  -q bytes      per connection buffer (256K)   -S seed    -U  impair client to server too
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <csignal>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using boost::system::error_code;
+using clk = std::chrono::steady_clock;
+using ms  = std::chrono::milliseconds;
+
+struct profile {
+    double   rate = 0;  // bytes/s, 0: uncapped
+    ms       delay{0}, jitter{0};
+    ms       stall_every{0}, stall_for{0};
+};
+
+struct stats {
+    uint64_t bytes = 0, stalls = 0;
+    size_t   peak  = 0; // buffered in the proxy
+    clk::duration paused{}; // not reading from the source, buffer full
+};
+
+// one direction: reads from `from` as long as there is room, writes to `to`
+// as the impairments allow. Done once `from`'s end of stream has been passed
+// on as a shutdown of `to`'s sending side, or failed when `to` can't be
+// written; on_done(true) or on_done(false), once
+struct pump : std::enable_shared_from_this<pump> {
+    pump(tcp::socket& from, tcp::socket& to, profile p, size_t limit, std::mt19937 rng, std::function<void(bool)> on_done)
+        : _from(from), _to(to), _p(p), _limit(limit), _rng(rng), _timer(to.get_executor()),
+          _on_done(std::move(on_done)) {
+        _tokens = _p.rate / 100;
+        _refilled = clk::now();
+        schedule_stall(_refilled);
+    }
+
+    void start() { read(); }
+    stats const& get_stats() const { return _stats; }
+
+    void stop() {
+        _closed = true;
+        _timer.cancel();
+    }
+
+  private:
+    struct chunk {
+        clk::time_point due;
+        std::string     data;
+        size_t          off = 0;
+    };
+
+    void read() {
+        if (_buffered >= _limit) { // resumed by write()
+            _paused_at = clk::now();
+            return;
+        }
+        _reading = true;
+        _from.async_read_some(ba::buffer(_buf, _limit - _buffered), [this,self=shared_from_this()](error_code ec, size_t n) {
+                _reading = false;
+                if (_closed) return;
+                if (n) {
+                    auto due = clk::now() + _p.delay;
+                    if (_p.jitter.count())
+                        due += ms(std::uniform_int_distribution<int64_t>(0, _p.jitter.count())(_rng));
+                    if (!_q.empty()) // reordering is not what TCP does
+                        due = std::max(due, _q.back().due);
+                    _q.push_back({due, std::string(_buf.data(), n)});
+                    _buffered += n;
+                    _stats.peak = std::max(_stats.peak, _buffered);
+                    write();
+                }
+                if (ec) {
+                    _eof = true;
+                    return write();
+                }
+                read();
+            });
+    }
+
+    void write() {
+        if (_writing || _closed)
+            return;
+        if (_q.empty()) {
+            if (_eof) { // a half-close stays one: the other direction carries on
+                error_code ec;
+                _to.shutdown(tcp::socket::shutdown_send, ec);
+                _closed = true;
+                _on_done(true);
+            }
+            return;
+        }
+
+        auto now = clk::now();
+        if (_p.stall_every.count() && now >= _next_stall) {
+            ++_stats.stalls;
+            _stalled_until = _next_stall + _p.stall_for;
+            schedule_stall(_stalled_until);
+        }
+        auto& front = _q.front();
+        if (now < _stalled_until)
+            return wait_until(_stalled_until);
+        if (now < front.due)
+            return wait_until(front.due);
+
+        size_t n = front.data.size() - front.off;
+        if (_p.rate) {
+            _tokens = std::min(_tokens + std::chrono::duration<double>(now - _refilled).count() * _p.rate,
+                               std::max(_p.rate / 100, 1.0)); // 10ms burst
+            _refilled = now;
+            n = std::min(n, size_t(_tokens));
+            if (!n)
+                return wait_until(now + std::chrono::duration_cast<clk::duration>(
+                                            std::chrono::duration<double>((1 - _tokens) / _p.rate)));
+            _tokens -= n;
+        }
+
+        _writing = true;
+        ba::async_write(_to, ba::buffer(front.data.data() + front.off, n), [this,self=shared_from_this()](error_code ec, size_t n) {
+                _writing = false;
+                if (ec || _closed) {
+                    if (!std::exchange(_closed, true)) _on_done(false);
+                    return;
+                }
+                _stats.bytes += n;
+                _buffered -= n;
+                if ((_q.front().off += n) == _q.front().data.size())
+                    _q.pop_front();
+                if (!_reading && !_eof && _buffered < _limit) {
+                    _stats.paused += clk::now() - _paused_at;
+                    read();
+                }
+                write();
+            });
+    }
+
+    void wait_until(clk::time_point t) {
+        _writing = true;
+        _timer.expires_at(t);
+        _timer.async_wait([this,self=shared_from_this()](error_code ec) {
+                _writing = false;
+                if (!ec) write();
+            });
+    }
+
+    void schedule_stall(clk::time_point from) {
+        if (_p.stall_every.count())
+            _next_stall = from + ms(int64_t(std::exponential_distribution<double>(1.0 / _p.stall_every.count())(_rng)));
+    }
+
+    tcp::socket&      _from;
+    tcp::socket&      _to;
+    profile           _p;
+    size_t            _limit, _buffered = 0;
+    std::mt19937      _rng;
+    ba::steady_timer  _timer;
+    std::function<void(bool)> _on_done;
+    std::deque<chunk> _q;
+    std::array<char, 64 << 10> _buf;
+    bool              _reading = false, _writing = false, _eof = false, _closed = false;
+    double            _tokens;
+    clk::time_point   _refilled, _next_stall, _stalled_until, _paused_at;
+    stats             _stats;
+};
+
+struct session : std::enable_shared_from_this<session> {
+    session(tcp::socket client, size_t id) : _client(std::move(client)), _server(_client.get_executor()), _id(id) {}
+
+    void start(tcp::endpoint server, profile down, profile up, size_t limit, uint32_t seed) {
+        _server.async_connect(server, [this,self=shared_from_this(),server,down,up,limit,seed](error_code ec) {
+                if (ec) {
+                    std::cout << "#" << _id << ": connect " << server << ": " << ec.message() << std::endl;
+                    return;
+                }
+                _server.set_option(tcp::no_delay(true), ec);
+                _client.set_option(tcp::no_delay(true), ec);
+
+                auto done = [this,self](bool ok) {
+                        if (!ok || ++_pumps_done == 2)
+                            close();
+                    };
+                std::seed_seq down_seed{seed, uint32_t(_id), 0u}, up_seed{seed, uint32_t(_id), 1u};
+                _down = std::make_shared<pump>(_server, _client, down, limit, std::mt19937(down_seed), done);
+                _up   = std::make_shared<pump>(_client, _server, up, limit, std::mt19937(up_seed), done);
+                _down->start();
+                _up->start();
+            });
+    }
+
+  private:
+    void close() { // both directions ended, or one failed: report once, tear down both
+        if (std::exchange(_done, true))
+            return;
+        auto& st = _down->get_stats();
+        std::cout << "#" << _id << ": " << st.bytes << " bytes to the client, " << st.stalls << " stalls, peak "
+                  << st.peak << " buffered, server held back for "
+                  << std::chrono::duration_cast<ms>(st.paused).count() << " ms" << std::endl;
+        _down->stop();
+        _up->stop();
+        _down.reset(); // each holds this session until its last handler
+        _up.reset();
+        error_code ec;
+        _client.close(ec);
+        _server.close(ec);
+    }
+
+    tcp::socket           _client, _server;
+    size_t                _id;
+    std::shared_ptr<pump> _down, _up;
+    int                   _pumps_done = 0; // directions closed in order
+    bool                  _done = false;
+};
+
+static double parse_size(std::string v) { // 1.5M, 100K
+    double mult = 1;
+    switch (v.empty() ? 0 : std::toupper(v.back())) {
+        case 'K': mult = 1e3; break;
+        case 'M': mult = 1e6; break;
+        case 'G': mult = 1e9; break;
+    }
+    if (mult != 1)
+        v.pop_back();
+    return std::stod(v) * mult;
+}
+
+static std::vector<std::string> split(std::string const& v) {
+    std::vector<std::string> out;
+    std::istringstream iss(v);
+    for (std::string item; getline(iss, item, ',');)
+        out.push_back(item);
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::vector<std::string> rates{"0"}, delays{"0"}, jitters{"0"}, stalls{"0:0"};
+    std::string host = "127.0.0.1";
+    unsigned short listen_port = 6769, port = 6767;
+    size_t limit = 256 << 10;
+    uint32_t seed = 1;
+    bool both_ways = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        auto& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        if      (arg == "-b" && has_value) rates = split(args[++i]);
+        else if (arg == "-d" && has_value) delays = split(args[++i]);
+        else if (arg == "-j" && has_value) jitters = split(args[++i]);
+        else if (arg == "-s" && has_value) stalls = split(args[++i]);
+        else if (arg == "-q" && has_value) limit = size_t(parse_size(args[++i]));
+        else if (arg == "-S" && has_value) seed = std::stoul(args[++i]);
+        else if (arg == "-l" && has_value) listen_port = static_cast<unsigned short>(std::stoi(args[++i]));
+        else if (arg == "-H" && has_value) host = args[++i];
+        else if (arg == "-p" && has_value) port = static_cast<unsigned short>(std::stoi(args[++i]));
+        else if (arg == "-U") both_ways = true;
+        else {
+            std::cerr << "usage: impair [-l port] [-H host] [-p port] [-b rate,...] [-d ms,...] [-j ms,...]"
+                         " [-s every:for,...] [-q bytes] [-S seed] [-U]" << std::endl;
+            return 1;
+        }
+    }
+    if (rates.empty() || delays.empty() || jitters.empty() || stalls.empty() || !limit)
+        return std::cerr << "impair: empty option" << std::endl, 1;
+
+    auto profile_for = [&](size_t n) {
+        profile p;
+        p.rate   = parse_size(rates[n % rates.size()]);
+        p.delay  = ms(std::stol(delays[n % delays.size()]));
+        p.jitter = ms(std::stol(jitters[n % jitters.size()]));
+        auto& s  = stalls[n % stalls.size()];
+        auto colon = s.find(':');
+        p.stall_every = ms(std::stol(s.substr(0, colon)));
+        p.stall_for   = ms(colon == std::string::npos ? 0 : std::stol(s.substr(colon + 1)));
+        return p;
+    };
+
+    ba::io_context ioc;
+    tcp::endpoint server{ba::ip::make_address(host), port};
+    tcp::acceptor acc(ioc, {ba::ip::address_v4::loopback(), listen_port});
+    ba::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&](error_code, int) { ioc.stop(); });
+
+    size_t accepted = 0;
+    std::function<void()> accept_loop = [&] {
+        acc.async_accept([&](error_code ec, tcp::socket client) {
+                if (ec) return;
+                auto n = accepted++;
+                auto p = profile_for(n);
+                std::cout << "#" << n << ": " << p.rate << " B/s, " << p.delay.count() << "+" << p.jitter.count()
+                          << " ms, stalls " << p.stall_for.count() << " ms every ~" << p.stall_every.count() << " ms"
+                          << std::endl;
+                std::make_shared<session>(std::move(client), n)
+                    ->start(server, p, both_ways ? p : profile{}, limit, seed);
+                accept_loop();
+            });
+    };
+    accept_loop();
+    ioc.run();
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// In-process duplex byte stream, interchangeable with tcp::socket as the
+// Protocol of basic_connection, for benchmarks and stress tests without the
+// kernel in the way.
+//
+// Each direction is a bounded buffer: writes complete with what fits and
+// wait for room, like a socket with a full send buffer. A drain rate caps
+// how fast the reading end can take bytes out (token bucket, refilled on a
+// timer), which simulates a slow consumer deterministically.
+//
+// Ends may live on different executors; completions always run through the
+// handler's associated executor (e.g. the connection's strand).
+namespace loopback {
+    namespace ba = boost::asio;
+    using boost::system::error_code;
+
+    struct options {
+        size_t capacity = 256 << 10; // bytes buffered per direction, like SO_SNDBUF + SO_RCVBUF
+        double rate     = 0;         // bytes/s the reader may take out, 0: unlimited
+    };
+
+    namespace detail {
+        // a move-only pending operation
+        struct op {
+            virtual ~op() = default;
+            virtual void complete(error_code ec, size_t n) = 0;
+        };
+
+        template <typename Handler, typename Executor> struct op_impl : op {
+            op_impl(Handler h, Executor ex) : _h(std::move(h)), _ex(ba::get_associated_executor(_h, ex)) {}
+            void complete(error_code ec, size_t n) override {
+                ba::post(_ex, [h = std::move(_h), ec, n]() mutable { h(ec, n); });
+            }
+            Handler _h;
+            ba::associated_executor_t<Handler, Executor> _ex;
+        };
+
+        template <typename Handler, typename Executor> std::unique_ptr<op> make_op(Handler&& h, Executor ex) {
+            return std::make_unique<op_impl<std::decay_t<Handler>, Executor>>(std::forward<Handler>(h), ex);
+        }
+
+        // one direction
+        struct pipe : std::enable_shared_from_this<pipe> {
+            using clk = std::chrono::steady_clock;
+
+            pipe(ba::any_io_executor timer_ex, options opts) : _opts(opts), _pacer(timer_ex), _refilled(clk::now()) {
+                _tokens = _opts.rate ? _opts.rate / 100 : 0; // 10ms worth to start
+            }
+
+            void async_write(std::vector<ba::const_buffer> bufs, std::unique_ptr<op> done) {
+                std::lock_guard<std::mutex> lk(_mx);
+                if (_closed)
+                    return done->complete(ba::error::broken_pipe, 0);
+                if (ba::buffer_size(bufs) == 0)
+                    return done->complete({}, 0);
+                _wbufs  = std::move(bufs);
+                _writer = std::move(done);
+                progress();
+            }
+
+            void async_read(std::vector<ba::mutable_buffer> bufs, std::unique_ptr<op> done) {
+                std::lock_guard<std::mutex> lk(_mx);
+                if (ba::buffer_size(bufs) == 0)
+                    return done->complete({}, 0);
+                _rbufs  = std::move(bufs);
+                _reader = std::move(done);
+                progress();
+            }
+
+            void close() { // either end: readers get EOF once drained, writers an error
+                std::lock_guard<std::mutex> lk(_mx);
+                _closed = true;
+                progress();
+            }
+
+            // each end only cancels its own side of the pipe
+            void cancel(bool reader) {
+                std::lock_guard<std::mutex> lk(_mx);
+                if (auto& op = reader ? _reader : _writer)
+                    std::exchange(op, nullptr)->complete(ba::error::operation_aborted, 0);
+            }
+
+            size_t buffered() const {
+                std::lock_guard<std::mutex> lk(_mx);
+                return _data.size() - _head;
+            }
+
+          private:
+            void progress() { // under _mx: move bytes writer -> buffer -> reader
+                if (_writer) {
+                    size_t room = _opts.capacity - (_data.size() - _head), n = 0;
+                    if (_head > _data.size() / 2) { // compact
+                        _data.erase(0, _head);
+                        _head = 0;
+                    }
+                    for (auto& b : _wbufs) {
+                        auto k = std::min(room - n, b.size());
+                        _data.append(static_cast<char const*>(b.data()), k);
+                        n += k;
+                    }
+                    if (_closed)
+                        std::exchange(_writer, nullptr)->complete(ba::error::broken_pipe, 0);
+                    else if (n)
+                        std::exchange(_writer, nullptr)->complete({}, n);
+                }
+
+                if (!_reader)
+                    return;
+                size_t avail = _data.size() - _head;
+                if (!avail) {
+                    if (_closed)
+                        std::exchange(_reader, nullptr)->complete(ba::error::eof, 0);
+                    return;
+                }
+                size_t allowed = avail;
+                if (_opts.rate) {
+                    refill();
+                    allowed = std::min(avail, size_t(_tokens));
+                    if (!allowed)
+                        return pace();
+                }
+                size_t n = 0;
+                for (auto& b : _rbufs) {
+                    auto k = std::min(allowed - n, b.size());
+                    std::memcpy(b.data(), _data.data() + _head + n, k);
+                    n += k;
+                }
+                _head += n;
+                if (_opts.rate)
+                    _tokens -= n;
+                std::exchange(_reader, nullptr)->complete({}, n);
+                if (_writer) // room again
+                    progress();
+            }
+
+            void refill() {
+                auto now = clk::now();
+                double secs = std::chrono::duration<double>(now - _refilled).count();
+                _tokens     = std::min(_tokens + secs * _opts.rate, std::max(_opts.rate / 100, 1.0)); // 10ms burst
+                _refilled   = now;
+            }
+
+            void pace() { // until the bucket has a byte again
+                if (_pacing)
+                    return;
+                _pacing = true;
+                auto wait = std::chrono::duration<double>((1 - _tokens) / _opts.rate);
+                _pacer.expires_after(std::max(std::chrono::duration_cast<clk::duration>(wait), clk::duration(std::chrono::microseconds(100))));
+                _pacer.async_wait([self = shared_from_this()](error_code ec) {
+                        std::lock_guard<std::mutex> lk(self->_mx);
+                        self->_pacing = false;
+                        if (!ec)
+                            self->progress();
+                    });
+            }
+
+            mutable std::mutex _mx;
+            options            _opts;
+            std::string        _data;
+            size_t             _head = 0;
+            bool               _closed = false, _pacing = false;
+            double             _tokens;
+            ba::steady_timer   _pacer;
+            clk::time_point    _refilled;
+
+            std::vector<ba::const_buffer>   _wbufs;
+            std::vector<ba::mutable_buffer> _rbufs;
+            std::unique_ptr<op>             _writer, _reader;
+        };
+    }
+
+    struct stream {
+        using executor_type = ba::any_io_executor;
+
+        explicit stream(ba::io_context& ioc) : _ex(ioc.get_executor()) {}
+        explicit stream(executor_type ex) : _ex(std::move(ex)) {}
+        stream(stream&&) = default;
+        stream& operator=(stream&&) = default;
+        ~stream() {
+            error_code ec;
+            close(ec);
+        }
+
+        executor_type get_executor() const { return _ex; }
+        bool          is_open() const { return _in && _out; }
+
+        template <typename Buffers, typename Token> auto async_read_some(Buffers const& bufs, Token&& token) {
+            return ba::async_initiate<Token, void(error_code, size_t)>(
+                [this](auto handler, Buffers const& bufs) {
+                    auto done = detail::make_op(std::move(handler), _ex);
+                    if (!_in)
+                        return done->complete(ba::error::not_connected, 0);
+                    _in->async_read({ba::buffer_sequence_begin(bufs), ba::buffer_sequence_end(bufs)}, std::move(done));
+                },
+                token, bufs);
+        }
+
+        template <typename Buffers, typename Token> auto async_write_some(Buffers const& bufs, Token&& token) {
+            return ba::async_initiate<Token, void(error_code, size_t)>(
+                [this](auto handler, Buffers const& bufs) {
+                    auto done = detail::make_op(std::move(handler), _ex);
+                    if (!_out)
+                        return done->complete(ba::error::not_connected, 0);
+                    _out->async_write({ba::buffer_sequence_begin(bufs), ba::buffer_sequence_end(bufs)}, std::move(done));
+                },
+                token, bufs);
+        }
+
+        void cancel(error_code& ec) {
+            ec.clear();
+            if (_in) _in->cancel(true);
+            if (_out) _out->cancel(false);
+        }
+
+        void close(error_code& ec) {
+            ec.clear();
+            if (_in) std::exchange(_in, nullptr)->close();
+            if (_out) std::exchange(_out, nullptr)->close();
+        }
+
+        size_t unread() const { return _in ? _in->buffered() : 0; }   // waiting for this end
+        size_t unsent() const { return _out ? _out->buffered() : 0; } // waiting for the peer
+
+        // wires two ends together; `a_to_b` simulates what a's peer drains
+        friend void connect(stream& a, stream& b, options a_to_b = {}, options b_to_a = {}) {
+            a._out = b._in = std::make_shared<detail::pipe>(b._ex, a_to_b);
+            b._out = a._in = std::make_shared<detail::pipe>(a._ex, b_to_a);
+        }
+
+      private:
+        executor_type                _ex;
+        std::shared_ptr<detail::pipe> _in, _out;
+    };
+
+    // for basic_connection<loopback::protocol>
+    struct protocol {
+        using socket = stream;
+    };
+}
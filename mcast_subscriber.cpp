@@ -0,0 +1,116 @@
+// Multicast subscriber: receives broadcasts as sequenced datagrams and repairs
+// gaps by NACKing over its (newline framed) TCP connection to the server.
+//
+//  g++ -std=c++17 -O2 mcast_subscriber.cpp -o mcast_subscriber -pthread
+//  ./test -m 239.255.0.1:6768 & ./mcast_subscriber [-d drop_rate]
+#include "multicast.hpp"
+#include <boost/asio.hpp>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using ba::ip::udp;
+using boost::system::error_code;
+using namespace std::string_literals;
+
+struct subscriber {
+    subscriber(ba::io_context& ioc, double drop_rate) : _tcp(ioc), _udp(ioc), _drop(drop_rate) {
+        _tcp.connect({ba::ip::address_v4::loopback(), 6767});
+        ba::write(_tcp, ba::buffer("!mcast\n"s));
+        read_loop();
+    }
+
+  private:
+    void read_loop() {
+        ba::async_read_until(_tcp, _rx, "\n", [this](error_code ec, size_t) {
+                std::string line;
+                if (!ec && getline(std::istream(&_rx), line)) {
+                    on_line(line);
+                    read_loop();
+                }
+                if (ec) {
+                    std::cout << "TCP closed (" << ec.message() << ")" << std::endl;
+                    _udp.close(ec);
+                }
+            });
+    }
+
+    void on_line(std::string const& line) {
+        std::istringstream iss(line);
+        std::string verb;
+        iss >> verb;
+
+        if (std::string group; verb == "!mcast" && iss >> group >> _port >> _expected) {
+            auto addr = ba::ip::make_address_v4(group);
+            _udp.open(udp::v4());
+            _udp.set_option(udp::socket::reuse_address(true));
+            _udp.bind({ba::ip::address_v4::any(), _port});
+            _udp.set_option(ba::ip::multicast::join_group(addr, ba::ip::address_v4::loopback()));
+            std::cout << "Joined " << group << ":" << _port << " at seq " << _expected << std::endl;
+            receive_loop();
+        } else if (uint64_t seq; verb == "!repair" && iss >> seq) {
+            iss.get(); // separator
+            std::string msg(std::istreambuf_iterator<char>(iss), {});
+            std::cout << "(repaired #" << seq << ")" << std::endl;
+            on_message(seq, std::move(msg));
+        } else {
+            std::cout << "TCP: " << line << std::endl;
+        }
+    }
+
+    void receive_loop() {
+        _udp.async_receive(ba::buffer(_dgram), [this](error_code ec, size_t n) {
+                if (ec || n < multicast::seq_size)
+                    return;
+
+                if (_dist(_prng) >= _drop) {
+                    auto seq = multicast::get_seq(_dgram.data());
+                    on_message(seq, std::string(_dgram.begin() + multicast::seq_size, _dgram.begin() + n));
+                }
+                receive_loop();
+            });
+    }
+
+    void on_message(uint64_t seq, std::string msg) {
+        if (seq < _expected)
+            return; // duplicate
+
+        if (seq > _expected && !_pending.count(seq)) {
+            uint64_t gap_end = _pending.empty() ? seq : std::min(seq, _pending.begin()->first);
+            if (gap_end > _nacked) { // don't NACK the same range twice
+                auto from = std::max(_expected, _nacked);
+                ba::write(_tcp, ba::buffer("!nack " + std::to_string(from) + " " + std::to_string(gap_end) + "\n"));
+                _nacked = gap_end;
+            }
+        }
+
+        _pending.emplace(seq, std::move(msg));
+        for (auto it = _pending.begin(); it != _pending.end() && it->first == _expected;
+             it = _pending.erase(it), ++_expected) {
+            std::cout << "#" << it->first << ": " << it->second << std::endl;
+        }
+    }
+
+    tcp::socket   _tcp;
+    udp::socket   _udp;
+    ba::streambuf _rx;
+    unsigned short _port = 0;
+    uint64_t _expected = 0, _nacked = 0;
+    std::map<uint64_t, std::string> _pending;
+    std::array<uint8_t, multicast::max_datagram> _dgram;
+
+    double _drop; // simulated packet loss
+    std::mt19937 _prng{std::random_device{}()};
+    std::uniform_real_distribution<double> _dist{0, 1};
+};
+
+int main(int argc, char** argv) {
+    double drop = argc > 2 && argv[1] == "-d"s ? std::stod(argv[2]) : 0;
+
+    ba::io_context ioc;
+    subscriber sub(ioc, drop);
+    ioc.run();
+}
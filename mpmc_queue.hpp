@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+// Bounded multi-producer multi-consumer queue (Dmitry Vyukov's design).
+//
+// Every cell carries a sequence number that says whose turn it is: a
+// producer claims a cell with one CAS on the enqueue position and publishes
+// it by bumping the sequence; consumers do the same on the dequeue side.
+// There are no locks and no allocations after construction, and producers
+// only contend with each other on the enqueue position.
+namespace mpmc {
+    template <typename T> struct queue {
+        explicit queue(size_t capacity) : _mask(checked(capacity) - 1), _cells(new cell[capacity]) {
+            for (size_t i = 0; i < capacity; ++i)
+                _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        queue(queue const&) = delete;
+        queue& operator=(queue const&) = delete;
+
+        size_t capacity() const { return _mask + 1; }
+
+        // false when full; `v` is left alone then
+        bool push(T& v) {
+            size_t pos = _enqueue.load(std::memory_order_relaxed);
+            for (;;) {
+                auto&    c   = _cells[pos & _mask];
+                size_t   seq = c.seq.load(std::memory_order_acquire);
+                intptr_t dif = intptr_t(seq) - intptr_t(pos);
+                if (dif == 0) {
+                    if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        c.data = std::move(v);
+                        c.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (dif < 0) {
+                    return false;
+                } else {
+                    pos = _enqueue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(T& out) {
+            size_t pos = _dequeue.load(std::memory_order_relaxed);
+            for (;;) {
+                auto&    c   = _cells[pos & _mask];
+                size_t   seq = c.seq.load(std::memory_order_acquire);
+                intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+                if (dif == 0) {
+                    if (_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        out = std::move(c.data);
+                        c.seq.store(pos + _mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (dif < 0) {
+                    return false;
+                } else {
+                    pos = _dequeue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+      private:
+        static size_t checked(size_t capacity) {
+            if (capacity < 2 || (capacity & (capacity - 1)))
+                throw std::invalid_argument("mpmc::queue: capacity must be a power of two");
+            return capacity;
+        }
+
+        struct cell {
+            std::atomic<size_t> seq;
+            T                   data;
+        };
+        static constexpr size_t line = 64;
+
+        size_t const                      _mask;
+        std::unique_ptr<cell[]>           _cells;
+        alignas(line) std::atomic<size_t> _enqueue{0}; // producers and consumers on separate lines
+        alignas(line) std::atomic<size_t> _dequeue{0};
+    };
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Sequenced UDP multicast fan-out: one datagram per broadcast, regardless of
+// the number of co-located subscribers.
+//
+// A datagram is an 8-byte big-endian sequence number followed by the payload.
+// Subscribers detect gaps and NACK them over their TCP connection, which is
+// where repairs come from. The publisher retains the last `history` messages;
+// payloads too large for a datagram are only ever delivered as repairs.
+namespace multicast {
+    namespace ba = boost::asio;
+    using ba::ip::udp;
+    using payload = std::shared_ptr<std::string const>;
+
+    static constexpr size_t seq_size     = 8;
+    static constexpr size_t max_datagram = 65507;
+
+    inline void put_seq(uint8_t* p, uint64_t seq) {
+        for (int i = 7; i >= 0; --i, seq >>= 8)
+            p[i] = uint8_t(seq);
+    }
+
+    inline uint64_t get_seq(uint8_t const* p) {
+        uint64_t seq = 0;
+        for (int i = 0; i < 8; ++i)
+            seq = seq << 8 | p[i];
+        return seq;
+    }
+
+    struct publisher {
+        publisher(ba::io_context& ioc, udp::endpoint group,
+                  ba::ip::address_v4 iface = ba::ip::address_v4::loopback(), size_t history = 4096)
+            : _group(group), _history_max(history), _s(ioc, udp::v4()) {
+            _s.set_option(ba::ip::multicast::enable_loopback(true)); // same-host subscribers
+            _s.set_option(ba::ip::multicast::hops(1));               // never leave the LAN
+            _s.set_option(ba::ip::multicast::outbound_interface(iface));
+        }
+
+        udp::endpoint group() const { return _group; }
+
+        uint64_t next_seq() {
+            std::lock_guard<std::mutex> lk(_mx);
+            return _next;
+        }
+
+        uint64_t publish(payload msg) { // returns the sequence number assigned
+            std::lock_guard<std::mutex> lk(_mx);
+            uint64_t seq = _next++;
+
+            _history.push_back(msg);
+            if (_history.size() > _history_max)
+                _history.pop_front();
+
+            if (msg->size() + seq_size <= max_datagram) {
+                uint8_t hdr[seq_size];
+                put_seq(hdr, seq);
+                boost::system::error_code ec; // best effort, gaps get repaired
+                _s.send_to(std::array<ba::const_buffer, 2>{{ba::buffer(hdr), ba::buffer(*msg)}}, _group, 0, ec);
+            }
+            return seq;
+        }
+
+        // calls f(seq, payload) for each retained message in [from, to)
+        template <typename F> size_t replay(uint64_t from, uint64_t to, F f) {
+            std::lock_guard<std::mutex> lk(_mx);
+            uint64_t oldest = _next - _history.size();
+            from = std::max(from, oldest);
+            to   = std::min(to, _next);
+            for (auto seq = from; seq < to; ++seq)
+                f(seq, _history[seq - oldest]);
+            return from < to ? to - from : 0;
+        }
+
+      private:
+        udp::endpoint       _group;
+        size_t              _history_max;
+        std::mutex          _mx;
+        uint64_t            _next = 0;
+        std::deque<payload> _history;
+        udp::socket         _s;
+    };
+}
@@ -0,0 +1,212 @@
+// Replays a capture (./test -c capture.bin) against a server on this host:
+// the same connections, opened, written to and closed at the recorded
+// times, optionally faster (-x 10: ten times the pace). Broadcasts and state
+// updates go into the server's feed (./test -I fifo) when given -f fifo,
+// length-prefixed after a hello byte, or as lines with -n.
+//
+// Reports how late the replay kept to the schedule, and what came back.
+//
+//  g++ -std=c++17 -O2 replay.cpp -o replay -pthread
+//  mkfifo /tmp/feed && ./test -I /tmp/feed & ./replay capture.bin -f /tmp/feed -x 2
+#include "capture.hpp"
+#include "framing.hpp"
+#include <boost/asio.hpp>
+#include <fcntl.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using boost::system::error_code;
+using clk = std::chrono::steady_clock;
+
+struct client : std::enable_shared_from_this<client> {
+    explicit client(ba::io_context& ioc) : s(ioc) {}
+
+    void read_loop(uint64_t& received) {
+        s.async_read_some(ba::buffer(buf), [this,self=shared_from_this(),&received](error_code ec, size_t n) {
+                received += n;
+                if (!ec)
+                    read_loop(received);
+            });
+    }
+
+    tcp::socket s;
+    bool        binary = false;
+    std::array<char, 64 << 10> buf;
+};
+
+struct replayer {
+    replayer(ba::io_context& ioc, std::string const& path, tcp::endpoint server, double speed, int feed_fd, bool newline)
+        : _ioc(ioc), _capture(path), _server(server), _speed(speed), _feed_fd(feed_fd), _newline(newline), _timer(ioc) {
+        if (_feed_fd >= 0 && !_newline) {
+            char hello = char(framing::hello_magic);
+            write_feed({&hello, 1});
+        }
+        _start = clk::now();
+        next();
+    }
+
+    void report() const {
+        auto lat = _late;
+        std::sort(lat.begin(), lat.end());
+        auto pct = [&](double p) { return lat.empty() ? 0 : lat[std::min(lat.size() - 1, size_t(p / 100 * lat.size()))]; };
+        std::cout << _done << " records over " << _span_us / 1e6 / _speed << " s: " << _opened << " connections, "
+                  << _sent << " messages sent, " << _broadcasts << " broadcasts (" << _skipped << " skipped)\n"
+                  << "late p50 " << pct(50) << " us, p99 " << pct(99) << " us, max " << (lat.empty() ? 0 : lat.back())
+                  << " us; " << _received << " bytes received" << std::endl;
+    }
+
+  private:
+    void next() {
+        if (!_capture.next(_r)) {
+            _conns.clear(); // closes what the capture left open
+            return;
+        }
+        auto due = _start + std::chrono::microseconds(int64_t(_r.at_us / _speed));
+        _timer.expires_at(due);
+        _timer.async_wait([this, due](error_code ec) {
+                if (ec) return;
+                _late.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clk::now() - due).count());
+                apply();
+                _span_us = _r.at_us;
+                ++_done;
+                next();
+            });
+    }
+
+    void apply() {
+        using capture::kind;
+        error_code ec;
+        switch (_r.what) {
+            case kind::open: {
+                auto c = std::make_shared<client>(_ioc);
+                c->s.connect(_server, ec);
+                if (ec) {
+                    std::cout << "connect: " << ec.message() << std::endl;
+                    return;
+                }
+                c->s.set_option(tcp::no_delay(true));
+                c->read_loop(_received);
+                _conns[_r.conn] = c;
+                ++_opened;
+                break;
+            }
+            case kind::hello:
+                if (auto c = find(); c && !_r.payload.empty() && _r.payload[0]) {
+                    c->binary = true;
+                    ba::write(c->s, ba::buffer(_r.payload), ec);
+                }
+                break;
+            case kind::rx:
+                if (auto c = find()) {
+                    send(c->s, c->binary);
+                    ++_sent;
+                }
+                break;
+            case kind::close:
+                if (auto c = find()) {
+                    c->s.shutdown(tcp::socket::shutdown_both, ec);
+                    c->s.close(ec);
+                    _conns.erase(_r.conn);
+                }
+                break;
+            case kind::broadcast:
+            case kind::state:
+                if (_feed_fd < 0) {
+                    ++_skipped;
+                    break;
+                }
+                if (_newline) {
+                    write_feed(_r.payload + '\n');
+                } else {
+                    auto h = framing::header{0, uint32_t(_r.payload.size())}.encode();
+                    write_feed({reinterpret_cast<char const*>(h.data()), h.size()});
+                    write_feed(_r.payload);
+                }
+                ++_broadcasts;
+                break;
+        }
+    }
+
+    std::shared_ptr<client> find() {
+        auto it = _conns.find(_r.conn);
+        return it == _conns.end() ? nullptr : it->second;
+    }
+
+    void send(tcp::socket& s, bool binary) {
+        error_code ec;
+        if (binary) {
+            auto h = framing::header{0, uint32_t(_r.payload.size())}.encode();
+            std::array<ba::const_buffer, 2> bufs{{ba::buffer(h), ba::buffer(_r.payload)}};
+            ba::write(s, bufs, ec);
+        } else {
+            std::array<ba::const_buffer, 2> bufs{{ba::buffer(_r.payload), ba::buffer("\n", 1)}};
+            ba::write(s, bufs, ec);
+        }
+    }
+
+    void write_feed(std::string_view data) {
+        while (!data.empty()) {
+            auto n = ::write(_feed_fd, data.data(), data.size());
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::perror("feed");
+                _feed_fd = -1;
+                return;
+            }
+            data.remove_prefix(n);
+        }
+    }
+
+    ba::io_context&   _ioc;
+    capture::reader   _capture;
+    capture::record   _r;
+    tcp::endpoint     _server;
+    double            _speed;
+    int               _feed_fd;
+    bool              _newline;
+    ba::steady_timer  _timer;
+    clk::time_point   _start;
+    std::map<uint64_t, std::shared_ptr<client>> _conns;
+    std::vector<int64_t> _late;
+    uint64_t _done = 0, _opened = 0, _sent = 0, _broadcasts = 0, _skipped = 0, _received = 0, _span_us = 0;
+};
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string path, feed, host = "127.0.0.1";
+    unsigned short port = 6767;
+    double speed = 1;
+    bool newline = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        auto& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        if      (arg == "-x" && has_value) speed = std::stod(args[++i]);
+        else if (arg == "-f" && has_value) feed = args[++i];
+        else if (arg == "-n") newline = true;
+        else if (arg == "-H" && has_value) host = args[++i];
+        else if (arg == "-p" && has_value) port = static_cast<unsigned short>(std::stoi(args[++i]));
+        else path = arg;
+    }
+    if (path.empty() || speed <= 0) {
+        std::cerr << "usage: replay capture.bin [-x speed] [-f feed_fifo [-n]] [-H host] [-p port]" << std::endl;
+        return 1;
+    }
+
+    int feed_fd = -1;
+    if (!feed.empty() && (feed_fd = ::open(feed.c_str(), O_WRONLY | O_CLOEXEC)) < 0) // waits for the reader
+        return std::perror(feed.c_str()), 1;
+
+    ba::io_context ioc;
+    replayer r(ioc, path, {ba::ip::make_address(host), port}, speed, feed_fd, newline);
+    ioc.run();
+    r.report();
+    if (feed_fd >= 0)
+        ::close(feed_fd);
+}
@@ -0,0 +1,1624 @@
+#pragma once
+#include <utility> // before Asio: Boost 1.74's awaitable.hpp uses std::exchange without it in C++20
+#include <boost/asio.hpp>
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <iostream>
+#include <unistd.h>
+#include "affinity.hpp"
+#include "busy_poll.hpp"
+#include "capture.hpp"
+#include "compression.hpp"
+#include "envelope.hpp"
+#include "feed.hpp"
+#include "file_payload.hpp"
+#include "framing.hpp"
+#include "loopback.hpp"
+#include "mpmc_queue.hpp"
+#include "multicast.hpp"
+#include "shm_ring.hpp"
+#include "udp_fanout.hpp"
+#include "uring_fanout.hpp"
+#include "work_stealing.hpp"
+#include "zerocopy.hpp"
+#ifdef BROADCAST_COROUTINES // C++20: the read and write loops as coroutines
+#include "coro.hpp"
+#endif
+
+namespace ba = boost::asio;
+using ba::ip::tcp;
+using ba::ip::udp;
+using boost::system::error_code;
+
+inline bool s_verbose = false;
+
+using payload = std::shared_ptr<std::string const>;
+
+using file_region = std::shared_ptr<file_payload::region const>;
+
+struct message { // one per broadcast, shared by all recipients
+    payload     raw;
+    payload     deflated = {}; // only if compression is enabled and worthwhile
+    uint8_t     flags    = 0;  // header flags for raw
+    file_region file     = {}; // instead of raw: sent from the file with sendfile
+};
+
+struct server_options {
+    framing::mode framing  = framing::mode::detect; // per connection, on the first byte received
+    std::chrono::milliseconds hello_window{200};     // detect: newline, if no byte has come by then
+    bool          compress = false;                  // deflate broadcasts (once, shared)
+    std::optional<udp::endpoint> multicast;          // also publish broadcasts to this group
+    bool          udp_state = false;                 // clients may take state updates over UDP
+    std::string   unix_path;                         // also listen on this AF_UNIX stream socket
+    std::string   shm_ring;                          // also write broadcasts to this shm ring
+    size_t        zerocopy_threshold = 0;            // MSG_ZEROCOPY for payloads this large, 0: off
+    bool          io_uring = false;                  // batch broadcast writes through io_uring, if available
+    work_stealing::pool* handlers = nullptr;         // run connection handlers here, not on the io thread
+    std::vector<ba::io_context*> shards;             // spread connections over these, each run by one thread
+    std::chrono::milliseconds rebalance{0};          // period for migrating hot connections between shards
+    bool          accept_thread = false;             // accept on a thread of its own, hand off to the least loaded
+    affinity::cpus accept_cpus;                      // pin the accept thread (see affinity.hpp)
+    std::chrono::microseconds busy_poll{0};          // SO_BUSY_POLL on connections (see busy_poll.hpp)
+    size_t        ingress_capacity = 4096;           // publish() queue, a power of two
+    std::string   feed;                              // broadcast what this file, FIFO or "-" (stdin) carries
+    size_t        feed_backlog = 1024;               // pause the feed while a connection has this many queued
+    std::string   capture;                           // record client traffic and broadcasts here (see replay.cpp)
+};
+
+// compile-time choices for connections
+namespace policy {
+    // framing: from server_options::framing and the first byte, or fixed
+    struct any_framing {
+        static constexpr bool fixed = false;
+    };
+    template <framing::mode M> struct fixed_framing {
+        static_assert(M != framing::mode::detect, "detect is any_framing");
+        static constexpr bool          fixed = true;
+        static constexpr framing::mode mode  = M;
+    };
+    using newline_framing = fixed_framing<framing::mode::newline>;
+    using binary_framing  = fixed_framing<framing::mode::length_prefixed>;
+
+    // threading: handlers on a strand, so they may run on a handler pool or
+    // move to another shard; or all on the one io thread, with no strand, no
+    // locks and no atomics on the registry, load counters or reference counts.
+    // Single-threaded, the server is only to be called on its io thread
+    // (producers on other threads use publish()).
+    struct atomic_count {
+        void add() { _n.fetch_add(1, std::memory_order_relaxed); }
+        bool release() { return _n.fetch_sub(1, std::memory_order_acq_rel) == 1; } // true: the last
+        bool try_add() { // not once it has reached zero, like weak_ptr::lock
+            auto n = _n.load(std::memory_order_relaxed);
+            while (n && !_n.compare_exchange_weak(n, n + 1, std::memory_order_relaxed))
+                ;
+            return n;
+        }
+        std::atomic<uint32_t> _n{0};
+    };
+    struct plain_count {
+        void add() { ++_n; }
+        bool release() { return --_n == 0; }
+        bool try_add() { return _n && ++_n; }
+        uint32_t _n = 0;
+    };
+    struct null_mutex {
+        void lock() {}
+        void unlock() {}
+    };
+    template <typename T> struct plain_atomic { // what std::atomic is used for here, as a plain T
+        plain_atomic(T v = T()) : _v(v) {}
+        T load(std::memory_order = std::memory_order_seq_cst) const { return _v; }
+        void store(T v, std::memory_order = std::memory_order_seq_cst) { _v = v; }
+        T fetch_add(T n, std::memory_order = std::memory_order_seq_cst) { return std::exchange(_v, _v + n); }
+        operator T() const { return _v; }
+        plain_atomic& operator=(T v) { _v = v; return *this; }
+        T _v;
+    };
+
+    struct strand_threaded {
+        static constexpr bool concurrent = true;
+        using executor = ba::strand<ba::executor>;
+        using refcount = atomic_count;
+        using mutex    = std::mutex;
+        template <typename T> using atomic = std::atomic<T>;
+    };
+    struct single_threaded {
+        static constexpr bool concurrent = false;
+        using executor = ba::io_context::executor_type;
+        using refcount = plain_count;
+        using mutex    = null_mutex;
+        template <typename T> using atomic = plain_atomic<T>;
+    };
+
+    // logging: -v at runtime, or none compiled in
+    struct verbose_logging {
+        static bool on() { return s_verbose; }
+    };
+    struct no_logging {
+        static constexpr bool on() { return false; }
+    };
+
+    // what the server builds its connections with:
+    //   -DBROADCAST_SINGLE_THREADED  no handler pools, shards or accept thread
+    //   -DBROADCAST_NEWLINE_ONLY     newline framing only, server_options::framing is ignored
+    //   -DBROADCAST_NO_LOGGING       no per-operation logging, whatever -v says
+    // and, independently, -DBROADCAST_COROUTINES -std=c++20 runs the read and
+    // write loops as coroutines (coro.hpp) instead of callback chains
+#ifdef BROADCAST_SINGLE_THREADED
+    using default_threading = single_threaded;
+#else
+    using default_threading = strand_threaded;
+#endif
+#ifdef BROADCAST_NEWLINE_ONLY
+    using default_framing = newline_framing;
+#else
+    using default_framing = any_framing;
+#endif
+#ifdef BROADCAST_NO_LOGGING
+    using default_logging = no_logging;
+#else
+    using default_logging = verbose_logging;
+#endif
+}
+
+struct server;
+struct registry;
+
+#ifdef BROADCAST_COUNT_REFS // for bench_refcount
+inline thread_local uint64_t s_ref_ops = 0;
+#define COUNT_REF_OP() ++s_ref_ops
+#else
+#define COUNT_REF_OP()
+#endif
+
+struct connection;
+using connptr = boost::intrusive_ptr<connection>;
+
+// a weak reference: the registry slot and the generation it was taken in. A
+// slot is reused with the next generation, so a stale id never finds the
+// connection that took its place.
+struct conn_id {
+    uint32_t slot = 0, gen = 0;
+};
+
+// what the server sees of a connection, whatever the transport
+struct connection {
+    virtual ~connection();
+    connection() = default;
+    connection(connection const&) = delete;
+    connection& operator=(connection const&) = delete;
+
+    virtual void send(message msg, bool at_front = false) = 0;
+    virtual void send_batch(std::shared_ptr<std::vector<message> const> batch, bool at_front) = 0; // in order
+    virtual std::string peer() const = 0;
+
+    void send(std::string msg, bool at_front = false) {
+        send(message{std::make_shared<std::string const>(std::move(msg))}, at_front);
+    }
+
+    // intrusive reference count: in the object, no control block to
+    // allocate, and a plain integer in a single-threaded build
+    connptr ref() { return connptr(this); }
+
+    friend void intrusive_ptr_add_ref(connection* c) {
+        COUNT_REF_OP();
+        c->_refs.add();
+    }
+
+    friend void intrusive_ptr_release(connection* c) {
+        COUNT_REF_OP();
+        if (c->_refs.release())
+            delete c;
+    }
+
+  protected:
+    friend struct server;
+    friend struct registry;
+
+    policy::default_threading::refcount _refs;
+
+    bool try_ref() { // for the registry, where the connection may be on its way out
+        COUNT_REF_OP();
+        return _refs.try_add();
+    }
+
+    std::shared_ptr<registry>     _registry;             // set when registered
+    conn_id                       _id;
+
+    template <typename T> using atomic = policy::default_threading::atomic<T>;
+
+    atomic<bool> _via_multicast{false}; // receives broadcasts by multicast instead
+    atomic<bool> _via_udp{false};       // receives state updates by UDP instead
+
+    // batched fan-out, on the io thread: an idle connection is claimed for a
+    // write of the whole frame that the server submits itself, anything else
+    // just queues the message
+    enum class wire { newline, binary, deflated };
+    struct direct_claim {
+        int  fd;
+        wire encoding;
+    };
+    virtual std::optional<direct_claim> claim_direct(message const& msg) = 0;
+    virtual void direct_written(int res, size_t frame_size) = 0; // res: bytes or -errno
+
+    // load, as sampled by the rebalancer, and moving the socket to another shard
+    atomic<uint64_t>              _cpu_ns{0}, _bytes{0}; // handler CPU time, payload bytes in and out
+    atomic<size_t>                _queued{0};            // tx queue length, for the feed's backpressure
+    atomic<ba::io_context*>       _home;
+    std::shared_ptr<void>         _census;               // its shard's, see server::io_shard
+    uint64_t                      _sampled = 0;          // _cpu_ns + _bytes at the last sample
+    virtual void migrate(ba::io_context& to, std::shared_ptr<void> census) = 0; // census: to's, if it has one
+
+    virtual void start() = 0; // on its I/O thread, once configured and registered
+
+    std::shared_ptr<capture::writer> _capture;           // set when registered
+    uint64_t                      _capture_id = 0;
+};
+
+// the server's connections, by slot; a broadcast takes a reference to each
+// live one without a weak_ptr, and its control block, per connection
+struct registry {
+    using mutex = policy::default_threading::mutex;
+
+    struct entry {
+        connection* c   = nullptr;
+        uint32_t    gen = 0;
+    };
+
+    size_t add(connection& c) { // returns the number registered so far
+        std::lock_guard<mutex> lk(_mx);
+        uint32_t slot;
+        if (_free.empty()) {
+            slot = _slots.size();
+            _slots.emplace_back();
+        } else {
+            slot = _free.back();
+            _free.pop_back();
+        }
+        _slots[slot].c = &c;
+        c._id = {slot, _slots[slot].gen};
+        return ++_added;
+    }
+
+    void remove(conn_id id) { // from the connection's destructor
+        std::lock_guard<mutex> lk(_mx);
+        auto& e = _slots[id.slot];
+        if (e.gen != id.gen)
+            return;
+        e.c = nullptr;
+        ++e.gen;
+        _free.push_back(id.slot);
+    }
+
+    bool alive(conn_id id) {
+        std::lock_guard<mutex> lk(_mx);
+        return _slots[id.slot].gen == id.gen;
+    }
+
+    std::vector<connptr> active() {
+        std::vector<connptr> out;
+        std::lock_guard<mutex> lk(_mx);
+        out.reserve(_slots.size() - _free.size());
+        for (auto& e : _slots)
+            if (e.c && e.c->try_ref())
+                out.emplace_back(e.c, false);
+        return out;
+    }
+
+  private:
+    mutex                 _mx;
+    std::vector<entry>    _slots;
+    std::vector<uint32_t> _free;
+    size_t                _added = 0;
+};
+
+inline connection::~connection() {
+    if (_registry)
+        _registry->remove(_id);
+    if (_capture)
+        _capture->close(_capture_id);
+}
+
+// Protocol: tcp, ba::local::stream_protocol or loopback::protocol; TxQueue: a
+// sequence container for the outgoing messages (std::list, std::deque)
+template <typename Protocol, typename Framing = policy::default_framing, template <typename...> class TxQueue = std::list,
+          typename Threading = policy::default_threading, typename Logging = policy::default_logging>
+struct basic_connection : connection {
+    using socket_type = typename Protocol::socket;
+
+    // a socket with a descriptor: sendfile, zerocopy, migration. Not so the
+    // in-memory loopback::stream, which only does Asio's stream operations.
+    static constexpr bool kernel_socket = !std::is_same_v<Protocol, loopback::protocol>;
+
+    basic_connection(server& srv, ba::io_context& ioc, server_options const& opts)
+        : _server(srv), _mode(initial_mode(opts)), _ready(_mode == framing::mode::newline),
+          _hello_window(opts.hello_window), _hello_timer(ioc),
+          _zc_threshold(opts.zerocopy_threshold), _busy_poll(opts.busy_poll),
+          _handlers(Threading::concurrent ? opts.handlers : nullptr),
+          _metered(opts.shards.size() > 1 && opts.rebalance.count()),
+          _relocating(Threading::concurrent && !_handlers && opts.shards.size() > 1),
+          _strand(make_strand(ioc, _handlers)), _s(ioc) {
+        _home = &ioc;
+    }
+
+    void configure() { // the socket options, before anything is queued
+        if constexpr (kernel_socket) {
+            _s.non_blocking(true); // for sendfile and zerocopy
+            if (_zc_threshold)
+                _zc_enabled = zerocopy::enable(_s.native_handle()); // not for AF_UNIX
+            if (_busy_poll.count() && std::is_same_v<Protocol, tcp>)
+                busy_poll::enable(_s.native_handle(), _busy_poll);
+        }
+    }
+
+    void start() override {
+        if (mode() == framing::mode::newline)
+            return read_loop();
+        read_hello();
+        if (mode() == framing::mode::detect) // listen-only clients (nc) never send a byte
+            await_hello();
+    }
+
+    using connection::send;
+    void send(message msg, bool at_front = false) override {
+        on_strand([this,msg=std::move(msg),at_front]() mutable {
+            if (enqueue(std::move(msg), at_front))
+                write_loop();
+        });
+    }
+
+    void send_batch(std::shared_ptr<std::vector<message> const> batch, bool at_front) override { // one post for all
+        on_strand([this,batch=std::move(batch),at_front] {
+            bool start = false;
+            for (auto& m : *batch)
+                start = enqueue(m, at_front);
+            if (start)
+                write_loop();
+        });
+    }
+
+    std::string peer() const override {
+        error_code ec;
+        std::ostringstream oss;
+        if constexpr (std::is_same_v<Protocol, tcp>)
+            oss << _s.remote_endpoint(ec);
+        else if constexpr (!kernel_socket)
+            oss << "loopback:" << this;
+        else // AF_UNIX peers are typically unnamed
+            oss << "unix:" << _s.local_endpoint(ec).path();
+        return oss.str();
+    }
+
+    // the socket moves once nothing is being written: the pending read is
+    // cancelled, parks where it was, and resumes on the new io_context
+    void migrate(ba::io_context& to, std::shared_ptr<void> census) override {
+        on_strand([this,&to,census=std::move(census)]() mutable {
+            if (&to == _home || _moving || _zc_enabled || !kernel_socket || !Threading::concurrent) // zerocopy completions wait on the socket
+                return;
+            if (!_ready) // the hello window's timer stays behind
+                return;
+            _moving        = &to;
+            _moving_census = std::move(census);
+            if (!_in_flight) {
+                error_code ec;
+                _s.cancel(ec);
+            }
+        });
+    }
+
+  private:
+    struct outgoing {
+        payload     raw, deflated; // which goes out is up to the client's hello, see body()
+        uint8_t     flags;
+        file_region file;
+        bool        urgent;   // queued at_front
+        uint64_t    sent = 0; // of a chunked or file-backed message
+    };
+
+    // what goes on the wire for a queued message: decided when it is written,
+    // as messages may be queued before the hello says what the client takes
+    bool deflates(outgoing const& o) const { return o.deflated && (_caps & framing::cap_deflate); }
+    payload const& body(outgoing const& o) const { return deflates(o) ? o.deflated : o.raw; }
+    uint8_t flags(outgoing const& o) const { return deflates(o) ? framing::flag_deflate : o.flags; }
+    uint64_t size(outgoing const& o) const { return o.file ? o.file->size : body(o)->size(); }
+
+    std::optional<direct_claim> claim_direct(message const& msg) override {
+        bool idle = _ready && _tx.empty();
+        if (!enqueue(msg, true))
+            return {}; // behind a write in progress, or framing not known yet
+
+        auto& o = _tx.front();
+        if (!idle || o.file || chunked(o) || zerocopy_applies(o)) {
+            write_loop();
+            return {};
+        }
+        _in_flight = 1;
+        if constexpr (!kernel_socket) { // nothing to submit to, write it ourselves
+            _in_flight = 0;
+            write_loop();
+            return {};
+        } else if (mode() == framing::mode::newline) {
+            return direct_claim{_s.native_handle(), wire::newline};
+        } else {
+            return direct_claim{_s.native_handle(), deflates(o) ? wire::deflated : wire::binary};
+        }
+    }
+
+    void direct_written(int res, size_t frame_size) override {
+        if (Logging::on()) std::cout << "Tx: " << res << " bytes (io_uring)" << std::endl;
+        if (res == int(frame_size)) {
+            if (dequeue()) write_loop();
+        } else if (res >= 0 || res == -EAGAIN || res == -ECANCELED) {
+            write_rest(std::max(res, 0)); // short write, or the engine didn't take it
+        } else {
+            std::cout << "Tx io_uring: " << std::strerror(-res) << std::endl;
+        }
+    }
+
+    template <typename F> void on_strand(F f) { // from any thread
+        auto strand = current_strand();
+        post(strand, [this,self=ref(),strand,f=std::move(f)]() mutable {
+            if (strand != current_strand()) // migrated meanwhile
+                return on_strand(std::move(f));
+            f();
+        });
+    }
+
+    typename Threading::executor current_strand() {
+        if (!_relocating) // never changes
+            return _strand;
+        std::lock_guard<typename Threading::mutex> lk(_strand_mx);
+        return _strand;
+    }
+
+    static typename Threading::executor make_strand(ba::io_context& ioc, work_stealing::pool* handlers) {
+        if constexpr (Threading::concurrent)
+            return ba::make_strand(handlers ? ba::executor(handlers->get_executor()) : ba::executor(ioc.get_executor()));
+        else
+            return ioc.get_executor();
+    }
+
+    static framing::mode initial_mode(server_options const& opts) {
+        if constexpr (Framing::fixed)
+            return Framing::mode;
+        else
+            return opts.framing;
+    }
+
+    framing::mode mode() const { // a constant, with fixed framing
+        if constexpr (Framing::fixed)
+            return Framing::mode;
+        else
+            return _mode;
+    }
+
+    // every completion handler: on the strand, with its CPU time metered
+    // when the rebalancer runs (two clock reads a handler), just run if not
+    template <typename F> auto bind(F f) {
+        return ba::bind_executor(_strand, [this,f=std::move(f)](auto&&... args) mutable {
+            if (!_metered)
+                return f(std::forward<decltype(args)>(args)...);
+            auto t0 = thread_cpu_ns();
+            f(std::forward<decltype(args)>(args)...);
+            _cpu_ns.fetch_add(thread_cpu_ns() - t0, std::memory_order_relaxed); // read by the rebalancer
+        });
+    }
+
+    static uint64_t thread_cpu_ns() {
+        timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1'000'000'000ull + ts.tv_nsec;
+    }
+
+    bool parked(error_code ec) const { return ec == ba::error::operation_aborted && _moving; }
+
+    void move_socket(std::function<void()> resume_read) { // nothing is outstanding on the socket
+        if constexpr (kernel_socket) {
+            auto& to = *std::exchange(_moving, nullptr);
+            error_code ec;
+            auto protocol = _s.local_endpoint(ec).protocol();
+            auto fd       = _s.release(ec);
+            if (ec) {
+                std::cout << "Migration failed: " << ec.message() << std::endl;
+                _moving_census.reset(); // stays counted where it is
+                return;
+            }
+
+            socket_type moved(to);
+            moved.assign(protocol, fd, ec);
+            moved.non_blocking(true, ec);
+            _s    = std::move(moved);
+            _home = &to;
+            if (_moving_census) // counts towards the new shard from now on
+                _census = std::move(_moving_census);
+            if (Logging::on()) std::cout << "Migrated " << peer() << std::endl;
+
+            if (!_handlers) { // from here on, sends may run on the new strand already
+                std::lock_guard<typename Threading::mutex> lk(_strand_mx);
+                _strand = make_strand(to, nullptr);
+            }
+            post(_strand, bind([this,self=ref(),resume_read] {
+                    resume_read();
+                    if (_ready && !_tx.empty() && !_in_flight)
+                        write_loop();
+                }));
+        }
+    }
+
+    void do_echo() { // the line becomes the echo's payload: sized once, no stream in between
+        auto data = _rx.data();
+        std::string_view buffered(static_cast<char const*>(data.data()), data.size());
+        if (buffered.empty())
+            return;
+        auto eol = buffered.find('\n');
+        std::string line(buffered.substr(0, eol));
+        _rx.consume(eol == buffered.npos ? buffered.size() : eol + 1);
+        on_message(std::move(line));
+    }
+
+    void on_message(std::string msg) {
+        _bytes.fetch_add(msg.size(), std::memory_order_relaxed);
+        if (_capture)
+            _capture->rx(_capture_id, msg);
+        if (msg.size() > 1 && msg[0] == '!')
+            on_command(msg);
+        else
+            send(std::move(msg)); // echo
+    }
+
+    void on_command(std::string const& cmd); // "!verb args..." control messages
+    void send_repair(uint64_t seq, payload const& msg);
+
+    bool enqueue(message msg, bool at_front)
+    { // returns true if need to start write loop
+        outgoing o{std::move(msg.raw), std::move(msg.deflated), msg.flags, std::move(msg.file), at_front};
+
+        if (at_front) { // behind whatever is being written, and the at_front ones before it
+            auto at = std::max(_in_flight, _urgent_end);
+            _tx.insert(nth(at), std::move(o));
+            _urgent_end = at + 1;
+        } else {
+            _tx.push_back(std::move(o));
+        }
+        _queued.store(_tx.size(), std::memory_order_relaxed);
+
+        return _ready && !_in_flight;
+    }
+    bool dequeue()
+    { // returns true if more messages pending after dequeue
+        assert(_tx.size() >= _in_flight);
+        auto done = std::next(begin(_tx), _in_flight);
+        for (auto it = begin(_tx); it != done; ++it)
+            _bytes.fetch_add(size(*it), std::memory_order_relaxed);
+        _tx.erase(begin(_tx), done);
+        _queued.store(_tx.size(), std::memory_order_relaxed);
+        _urgent_end -= std::min(_urgent_end, _in_flight);
+        _in_flight = 0;
+        if (_moving) { // writes resume after the move
+            error_code ec;
+            _s.cancel(ec);
+            return false;
+        }
+        return !_tx.empty();
+    }
+
+    bool chunked(outgoing const& o) const {
+        return mode() == framing::mode::length_prefixed && size(o) > framing::max_chunk;
+    }
+
+    void on_slice_written() { // continues with the next slice, or the next message
+        if (_tx.front().sent < size(_tx.front())) {
+            _in_flight = 0;
+            let_urgent_pass();
+            write_loop();
+        } else if (dequeue()) {
+            write_loop();
+        }
+    }
+
+    typename TxQueue<outgoing>::iterator nth(size_t i) { // from the nearer end, a list walks
+        if (i > _tx.size() / 2)
+            return std::prev(end(_tx), _tx.size() - i);
+        return std::next(begin(_tx), i);
+    }
+
+    void let_urgent_pass() { // whole at_front messages overtake the rest of a chunked one
+        auto partial = begin(_tx);
+        auto first = std::next(partial), last = first;
+        while (last != end(_tx) && last->urgent && !chunked(*last))
+            ++last;
+        _urgent_end = std::distance(first, last) + partial->urgent; // the partial one only if it is urgent itself
+        if constexpr (std::is_same_v<tx_queue, std::list<outgoing>>)
+            _tx.splice(partial, _tx, first, last);
+        else
+            std::rotate(partial, first, last);
+    }
+
+    size_t pack_newline() { // consecutive lines go out in one write
+        for (auto& o : _tx) {
+            if (_in_flight == envelope::max_count || o.file || zerocopy_applies(o))
+                break;
+            _tx_bufs.push_back(ba::buffer(*o.raw));
+            _tx_bufs.push_back(ba::buffer("\n", 1));
+            ++_in_flight;
+        }
+        return _in_flight;
+    }
+
+    size_t pack_envelope() { // returns number of entries, 0 if not worth it
+        size_t count = 0, total = 0;
+        for (auto& o : _tx) {
+            if (count == envelope::max_count || o.file || body(o)->size() > envelope::max_entry ||
+                (flags(o) & ~framing::flag_deflate))
+                break;
+            ++count;
+        }
+        if (count < 2)
+            return 0;
+
+        _tx_scratch.resize(count * envelope::max_varint); // no reallocation while referenced
+        auto it = begin(_tx);
+        for (size_t i = 0; i < count; ++i, ++it) {
+            auto tag = &_tx_scratch[i * envelope::max_varint];
+            auto& data = *body(*it);
+            auto  len  = envelope::put_varint(tag, envelope::entry_tag(data.size(), deflates(*it)));
+            _tx_bufs.push_back(ba::buffer(tag, len));
+            _tx_bufs.push_back(ba::buffer(data));
+            total += len + data.size();
+        }
+        _tx_header = framing::header{framing::flag_envelope, uint32_t(total)}.encode();
+        return count;
+    }
+
+    void write_loop() {
+        if (_moving) {
+            error_code ec;
+            _s.cancel(ec);
+            return;
+        }
+
+        auto& front = _tx.front();
+        if (chunked(front))
+            return write_chunk();
+        if (front.file) {
+            if (mode() == framing::mode::length_prefixed)
+                return write_file();
+            // the file may hold '\n' itself: not for line clients
+            if (Logging::on()) std::cout << "Tx: file dropped, newline framing" << std::endl;
+            _tx.erase(begin(_tx));
+            _queued.store(_tx.size(), std::memory_order_relaxed);
+            _urgent_end -= std::min<size_t>(_urgent_end, 1);
+            return _tx.empty() ? void() : write_loop();
+        }
+        if (zerocopy_applies(front)) {
+            auto& data = *body(front);
+            if (mode() == framing::mode::length_prefixed) {
+                _tx_header = framing::header{flags(front), uint32_t(data.size())}.encode();
+                return write_zerocopy(ba::buffer(_tx_header), data.data(), data.size(), {}, false);
+            }
+            return write_zerocopy({}, data.data(), data.size(), ba::buffer("\n", 1), false);
+        }
+
+#ifdef BROADCAST_COROUTINES
+        write_messages();
+    }
+
+    // the plain messages at the front of the queue, a write at a time, until
+    // the queue runs dry or something that takes another path comes up
+    coro::loop write_messages() {
+        do {
+            pack_frames();
+            auto [ec, n] = co_await async_op([this](auto handler) { ba::async_write(_s, _tx_bufs, std::move(handler)); });
+            if (Logging::on()) std::cout << "Tx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+            if (ec || !dequeue())
+                co_return;
+        } while (!_moving && !chunked(_tx.front()) && !_tx.front().file && !zerocopy_applies(_tx.front()));
+        write_loop();
+    }
+
+    // the handler goes through bind() and holds the connection, like the
+    // callbacks' `self`; a suspended loop lives only as long as its handler
+    template <typename Initiate> auto async_op(Initiate init) {
+        return coro::async([this,init=std::move(init)](coro::resumer h) {
+            init(bind([self=ref(),h=std::move(h)](error_code ec, size_t n) mutable { h(ec, n); }));
+        });
+    }
+#else
+        pack_frames();
+        ba::async_write(_s, _tx_bufs, bind([this,self=ref()](error_code ec, size_t n) {
+                if (Logging::on()) std::cout << "Tx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+                if (!ec && dequeue()) write_loop();
+            }));
+    }
+#endif
+
+    void pack_frames() {
+        // framing goes out by gather-write, payloads are never copied
+        _tx_bufs.clear();
+        if (mode() == framing::mode::length_prefixed) {
+            _tx_bufs.push_back(ba::buffer(_tx_header));
+            if (_caps & framing::cap_envelope)
+                _in_flight = pack_envelope();
+            if (!_in_flight) {
+                auto& front = _tx.front();
+                _tx_header = framing::header{flags(front), uint32_t(body(front)->size())}.encode();
+                _tx_bufs.push_back(ba::buffer(*body(front)));
+                _in_flight = 1;
+            }
+        } else {
+            pack_newline();
+        }
+    }
+
+    void write_rest(size_t skip) { // the front message, minus what was already written
+        auto& o = _tx.front();
+        _in_flight = 1;
+        _tx_bufs.clear();
+        if (mode() == framing::mode::length_prefixed) {
+            _tx_header = framing::header{flags(o), uint32_t(body(o)->size())}.encode();
+            _tx_bufs.push_back(ba::buffer(_tx_header));
+        }
+        _tx_bufs.push_back(ba::buffer(*body(o)));
+        if (mode() == framing::mode::newline)
+            _tx_bufs.push_back(ba::buffer("\n", 1));
+
+        for (auto& b : _tx_bufs) {
+            auto n = std::min(skip, b.size());
+            b += n;
+            skip -= n;
+        }
+        ba::async_write(_s, _tx_bufs, bind([this,self=ref()](error_code ec, size_t n) {
+                if (Logging::on()) std::cout << "Tx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+                if (!ec && dequeue()) write_loop();
+            }));
+    }
+
+    void write_chunk() { // one bounded slice of a large message
+        auto& o = _tx.front();
+        _in_flight = 1;
+
+        uint64_t len = std::min<uint64_t>(framing::max_chunk, size(o) - o.sent);
+        uint8_t  f   = flags(o) | framing::flag_chunk;
+        if (o.sent + len < size(o))
+            f |= framing::flag_more;
+        _tx_header = framing::header{f, uint32_t(len)}.encode();
+
+        if (o.file) {
+            ba::async_write(_s, ba::buffer(_tx_header), bind([this,self=ref(),end=o.sent+len](error_code ec, size_t) {
+                    if (!ec) send_file(end);
+                }));
+        } else if (zerocopy_applies(o, len)) {
+            write_zerocopy(ba::buffer(_tx_header), body(o)->data() + o.sent, len, {}, true);
+        } else {
+            std::array<ba::const_buffer, 2> bufs{{ba::buffer(_tx_header), ba::buffer(body(o)->data() + o.sent, len)}};
+            ba::async_write(_s, bufs, bind([this,self=ref(),len](error_code ec, size_t n) {
+                    if (Logging::on()) std::cout << "Tx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+                    if (ec) return;
+                    _tx.front().sent += len;
+                    on_slice_written();
+                }));
+        }
+    }
+
+    bool zerocopy_applies(outgoing const& o, size_t len = 0) const {
+        return _zc_enabled && !o.file && (len ? len : body(o)->size()) >= _zc_threshold;
+    }
+
+    // head and tail are small and copied, body goes out with MSG_ZEROCOPY and
+    // the front's payload is kept alive until the kernel acknowledges it
+    void write_zerocopy(ba::const_buffer head, char const* body, size_t len, ba::const_buffer tail, bool slice) {
+        _in_flight = 1;
+        _zc_op     = {head, body, len, tail, 0, slice};
+        if constexpr (kernel_socket) // never enabled otherwise
+            zerocopy_continue();
+    }
+
+    void zerocopy_continue() {
+        if constexpr (kernel_socket) { // never enabled otherwise
+            auto& op = _zc_op;
+            int   fd = _s.native_handle();
+            for (size_t total = op.head.size() + op.len + op.tail.size(); op.done < total;) {
+                ssize_t n;
+                if (op.done < op.head.size()) {
+                    n = ::send(fd, static_cast<char const*>(op.head.data()) + op.done, op.head.size() - op.done,
+                               MSG_MORE | MSG_NOSIGNAL);
+                } else if (size_t off = op.done - op.head.size(); off < op.len) {
+                    int more = op.tail.size() ? MSG_MORE : 0;
+                    n = ::send(fd, op.body + off, op.len - off, MSG_ZEROCOPY | MSG_NOSIGNAL | more);
+                    if (n > 0)
+                        _zc.sent(body(_tx.front()));
+                    else if (n < 0 && errno == ENOBUFS) // out of optmem for pinning, copy this once
+                        n = ::send(fd, op.body + off, op.len - off, MSG_NOSIGNAL | more);
+                } else {
+                    off = op.done - op.head.size() - op.len;
+                    n = ::send(fd, static_cast<char const*>(op.tail.data()) + off, op.tail.size() - off, MSG_NOSIGNAL);
+                }
+
+                if (n >= 0) {
+                    op.done += n;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    zerocopy_watch();
+                    return _s.async_wait(socket_type::wait_write, bind([this,self=ref()](error_code ec) {
+                            if (!ec) zerocopy_continue();
+                        }));
+                } else if (errno != EINTR) {
+                    std::cout << "Tx zerocopy: " << std::strerror(errno) << std::endl;
+                    return;
+                }
+            }
+
+            if (Logging::on()) std::cout << "Tx: " << op.done << " bytes (zerocopy)" << std::endl;
+            zerocopy_watch();
+            if (op.slice) {
+                _tx.front().sent += op.len;
+                on_slice_written();
+            } else if (dequeue()) {
+                write_loop();
+            }
+        }
+    }
+
+    void zerocopy_watch() { // completions arrive on the error queue
+        if constexpr (kernel_socket) { // never enabled otherwise
+            if (_zc.idle() || _zc_watching)
+                return;
+
+            _zc_watching = true;
+            _s.async_wait(socket_type::wait_error, bind([this,self=ref()](error_code ec) {
+                    _zc_watching = false;
+                    if (ec) return;
+                    _zc.reap(_s.native_handle());
+                    zerocopy_watch();
+                }));
+            _zc.reap(_s.native_handle()); // anything that arrived before the wait was armed
+        }
+    }
+
+    void write_file() { // header, then the file by sendfile; length-prefixed only
+        _in_flight = 1;
+        auto& o = _tx.front();
+        _tx_header = framing::header{flags(o), uint32_t(size(o))}.encode();
+        ba::async_write(_s, ba::buffer(_tx_header), bind([this,self=ref(),end=size(o)](error_code ec, size_t) {
+                if (!ec) send_file(end);
+            }));
+    }
+
+    // the header has promised the peer the whole file: nothing else can
+    // follow on this stream, the queue would only grow behind it
+    void broken_file(char const* why) {
+        std::cout << "Tx file: " << why << ", closing" << std::endl;
+        error_code ec;
+        _s.close(ec);
+    }
+
+    void send_file(uint64_t end) { // sends the front's file up to `end`
+        auto& o = _tx.front();
+        if constexpr (kernel_socket) {
+            if (int err = file_payload::send(_s.native_handle(), *o.file, o.sent, end)) {
+                if (err == EAGAIN)
+                    return _s.async_wait(socket_type::wait_write, bind([this,self=ref(),end](error_code ec) {
+                            if (!ec) send_file(end);
+                        }));
+                return broken_file(std::strerror(err));
+            }
+        } else if (o.sent < end) { // no sendfile, through a buffer a slice at a time
+            _tx_file.resize(std::min<uint64_t>(end - o.sent, framing::max_chunk));
+            auto n = ::pread(o.file->f->fd(), _tx_file.data(), _tx_file.size(), o.file->offset + o.sent);
+            if (n <= 0)
+                return broken_file(n ? std::strerror(errno) : "truncated");
+            return ba::async_write(_s, ba::buffer(_tx_file.data(), n), bind([this,self=ref(),end,n](error_code ec, size_t) {
+                    if (ec) return broken_file(ec.message().c_str());
+                    _tx.front().sent += n;
+                    send_file(end);
+                }));
+        }
+
+        if (Logging::on()) std::cout << "Tx: " << o.sent << "/" << size(o) << " bytes from file" << std::endl;
+        on_slice_written();
+    }
+
+#ifdef BROADCAST_COROUTINES
+    void read_loop() { read_lines(); }
+
+    coro::loop read_lines() {
+        for (;;) {
+            auto [ec, n] = co_await async_op([this](auto handler) { ba::async_read_until(_s, _rx, "\n", std::move(handler)); });
+            if (Logging::on()) std::cout << "Rx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+            if (parked(ec)) {
+                move_socket([this] { read_loop(); });
+                co_return;
+            }
+            do_echo();
+            if (ec)
+                co_return;
+        }
+    }
+#else
+    void read_loop() {
+        ba::async_read_until(_s, _rx, "\n", bind([this,self=ref()](error_code ec, size_t n) {
+                if (Logging::on()) std::cout << "Rx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+                if (parked(ec))
+                    return move_socket([this] { read_loop(); });
+                do_echo();
+                if (!ec)
+                    read_loop();
+            }));
+    }
+#endif
+
+    void on_framing_resolved() { // start writing whatever was queued meanwhile
+        _ready = true;
+        _hello_timer.cancel();
+        if (_capture)
+            _capture->hello(_capture_id, mode() == framing::mode::length_prefixed ? framing::hello_magic | _caps : 0);
+        if (!_tx.empty())
+            write_loop();
+    }
+
+    void await_hello() { // binary clients send the hello right away, anyone else gets newline framing
+        _hello_timer.expires_after(_hello_window);
+        _hello_timer.async_wait(bind([this,self=ref()](error_code ec) {
+                if (ec || _ready) return;
+                if (Logging::on()) std::cout << "No hello, newline framing" << std::endl;
+                _mode = framing::mode::newline;
+                on_framing_resolved();
+            }));
+    }
+
+    void read_hello() { // binary clients lead with a hello byte
+        ba::async_read(_s, ba::buffer(_rx_header, 1), bind([this,self=ref()](error_code ec, size_t) {
+                if (parked(ec))
+                    return move_socket([this] { read_hello(); });
+                if (ec) return;
+
+                if (_ready && framing::is_hello(_rx_header[0])) { // a slow binary client: lines would garble it
+                    std::cout << "Hello after the hello window, closing" << std::endl;
+                    _s.close(ec);
+                } else if (_ready) { // too late for a hello, newline framing it is
+                    _rx.sputc(_rx_header[0]);
+                    read_loop();
+                } else if (framing::is_hello(_rx_header[0])) {
+                    _mode = framing::mode::length_prefixed;
+                    _caps = framing::capabilities(_rx_header[0]);
+                    if (Logging::on()) std::cout << "Binary framing (caps " << int(_caps) << ")" << std::endl;
+                    on_framing_resolved();
+                    read_header();
+                } else if (mode() == framing::mode::detect) {
+                    _mode = framing::mode::newline;
+                    _rx.sputc(_rx_header[0]); // first byte of the first line
+                    on_framing_resolved();
+                    read_loop();
+                } else {
+                    std::cout << "Expected binary hello, closing" << std::endl;
+                    _s.close(ec);
+                }
+            }));
+    }
+
+    void read_header(size_t got = 0) { // exact reads, no scanning for delimiters
+        ba::async_read(_s, ba::buffer(_rx_header) + got, bind([this,self=ref(),got](error_code ec, size_t n) {
+                if (parked(ec))
+                    return move_socket([this,got=got+n] { read_header(got); });
+                if (ec) return;
+
+                auto h = framing::header::decode(_rx_header.data());
+                if (h.size > framing::max_body) {
+                    std::cout << "Oversized frame (" << h.size << " bytes), closing" << std::endl;
+                    _s.close(ec);
+                    return;
+                }
+                read_body(h);
+            }));
+    }
+
+    void read_body(framing::header h, size_t got = 0) {
+        _rx_body.resize(h.size);
+        ba::async_read(_s, ba::buffer(_rx_body) + got, bind([this,self=ref(),h,got](error_code ec, size_t n) {
+                if (Logging::on()) std::cout << "Rx: " << n << " bytes (" << ec.message() << ")" << std::endl;
+                if (parked(ec))
+                    return move_socket([this,h,got=got+n] { read_body(h, got); });
+                if (ec) return;
+
+                if (h.flags & framing::flag_chunk) { // reassemble
+                    _rx_partial += _rx_body;
+                    if (_rx_partial.size() > framing::max_body) {
+                        std::cout << "Oversized chunked message, closing" << std::endl;
+                        _s.close(ec);
+                        return;
+                    }
+                    if (!(h.flags & framing::flag_more))
+                        on_message(std::exchange(_rx_partial, {}));
+                } else {
+                    on_message(std::exchange(_rx_body, {}));
+                }
+                read_header();
+            }));
+    }
+
+    friend struct server;
+    server&                _server;
+    framing::mode          _mode;
+    uint8_t                _caps = 0;
+    bool                   _ready; // framing known, writes may start
+    std::chrono::milliseconds _hello_window;
+    ba::steady_timer       _hello_timer;
+    size_t                 _in_flight = 0; // _tx entries being written
+    size_t                 _urgent_end = 0; // at_front ones queued up to here, where the next goes
+    ba::streambuf          _rx;
+    framing::header::bytes _rx_header, _tx_header;
+    std::string            _rx_body, _rx_partial;
+    using tx_queue = TxQueue<outgoing>;
+    tx_queue               _tx;
+    std::vector<ba::const_buffer> _tx_bufs;
+    std::vector<uint8_t>   _tx_scratch; // envelope entry headers
+    std::vector<char>      _tx_file;    // file payloads, where there is no sendfile
+
+    struct zerocopy_op {
+        ba::const_buffer head;
+        char const*      body;
+        size_t           len;
+        ba::const_buffer tail;
+        size_t           done;
+        bool             slice;
+    };
+    size_t                 _zc_threshold;
+    bool                   _zc_enabled = false, _zc_watching = false;
+    zerocopy::tracker      _zc;
+    zerocopy_op            _zc_op;
+    std::chrono::microseconds _busy_poll;
+    work_stealing::pool*   _handlers;
+    bool                   _metered;    // _cpu_ns kept, for the rebalancer
+    bool                   _relocating; // _strand may change, see move_socket
+    typename Threading::mutex _strand_mx; // _strand changes when migrating
+    typename Threading::executor _strand; // all handlers, whichever thread runs them
+    ba::io_context*        _moving = nullptr;
+    std::shared_ptr<void>  _moving_census; // the destination shard's, taken on arrival
+    socket_type            _s;
+};
+
+struct server {
+    server(ba::io_context& ioc, server_options opts = {})
+        : _ioc(ioc), _opts(supported(std::move(opts))) {
+        if (!_opts.capture.empty())
+            _capture = std::make_shared<capture::writer>(_opts.capture);
+        if (_opts.multicast)
+            _mcast.emplace(_ioc, *_opts.multicast);
+        if (_opts.udp_state)
+            _udp.emplace(_ioc);
+        if (!_opts.shm_ring.empty())
+            _shm.emplace(_opts.shm_ring);
+        if (_opts.io_uring && (_opts.handlers || !_opts.shards.empty())) {
+            std::cout << "io_uring fan-out claims connections on the io thread, not with handler pools or shards" << std::endl;
+        } else if (_opts.io_uring) {
+            try {
+                _uring.emplace(_ioc);
+            } catch (std::system_error const& e) {
+                std::cout << "No io_uring, broadcasting with Asio writes (" << e.what() << ")" << std::endl;
+            }
+        }
+
+        if (_accept_ioc) {
+            if (_opts.shards.empty())
+                _io_shards.push_back(std::make_unique<io_shard>(_ioc));
+            for (auto shard : _opts.shards)
+                _io_shards.push_back(std::make_unique<io_shard>(*shard));
+        }
+
+        _acc.set_option(tcp::acceptor::reuse_address()); // before bind, or TIME_WAIT blocks restarts
+        _acc.bind({{}, 6767});
+        _acc.listen();
+        accept_loop(_acc);
+
+        if (!_opts.unix_path.empty()) {
+            ::unlink(_opts.unix_path.c_str()); // stale from a previous run
+            _uds_acc.emplace(_acc.get_executor(), ba::local::stream_protocol::endpoint(_opts.unix_path));
+            accept_loop(*_uds_acc);
+        }
+
+        if (_opts.shards.size() > 1 && _opts.rebalance.count())
+            rebalance_loop();
+
+        if (!_opts.feed.empty()) {
+            _feed.emplace(_ioc, _opts.feed, _opts.framing,
+                    [this](feed::batch b) { broadcast_batch(std::move(b), false); },
+                    [this] { return longest_queue() >= _opts.feed_backlog; });
+            _feed->start([](feed::stats const& st) {
+                    std::cout << "Feed done: " << st.messages << " messages, " << st.bytes << " bytes in " << st.batches
+                              << " batches (" << st.stalls << " stalls, " << st.malformed << " malformed)" << std::endl;
+                });
+        }
+        if (_accept_ioc)
+            _accept_thread = std::thread([this] {
+                    affinity::pin_this_thread(_opts.accept_cpus);
+                    _accept_ioc->run();
+                });
+    }
+
+    ~server() {
+        if (_accept_ioc) {
+            _accept_ioc->stop();
+            _accept_thread.join();
+        }
+    }
+
+    void stop() {
+        post(_acc.get_executor(), [this] {
+                _acc.cancel();
+                _acc.close();
+                if (_uds_acc) {
+                    _uds_acc->close();
+                    ::unlink(_opts.unix_path.c_str());
+                }
+                for (auto& shard : _io_shards)
+                    shard->work.reset();
+            });
+        if (_feed)
+            _feed->stop();
+        post(_ioc, [this] {
+                _stopped = true; // in case the timer already fired
+                _rebalance_timer.cancel();
+            });
+    }
+
+    size_t broadcast(std::string msg) { return broadcast(prepare(std::move(msg))); }
+
+    size_t broadcast(message m) {
+        if (_uring) { // claimed on the io thread, then one submission for all idle recipients
+            auto recipients = std::make_shared<std::vector<connptr>>();
+            auto n = for_each_active([&recipients](connection& c) {
+                if (!c._via_multicast)
+                    recipients->push_back(c.ref());
+            });
+            post(_ioc, [this, m, recipients] { fan_out(m, *recipients); });
+            return n;
+        }
+
+        return for_each_active([&m](connection& c) {
+            if (!c._via_multicast)
+                c.send(m, true);
+        });
+    }
+
+    // for producer threads: never blocks, and costs one contended CAS;
+    // false when the ingress queue is full. The io thread broadcasts what
+    // has queued up in batches, one post per connection for each.
+    bool publish(std::string msg) {
+        if (!_ingress.push(msg))
+            return false;
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the drain's clear
+        if (!_ingress_posted.load(std::memory_order_relaxed) && !_ingress_posted.exchange(true))
+            post(_ioc, [this] { drain_ingress(); });
+        return true;
+    }
+
+    size_t broadcast_state(std::string msg) { // unreliable where the client opted in
+        if (_capture)
+            _capture->state(msg);
+        message m{std::make_shared<std::string const>(std::move(msg))};
+        size_t n = _udp ? _udp->send(m.raw) : 0;
+
+        for_each_active([&m, &n](connection& c) {
+            if (!c._via_udp) {
+                c.send(m);
+                ++n;
+            }
+        });
+        return n;
+    }
+
+    // queued normally, never read into memory. To length-prefixed clients
+    // only: a line client can't tell a '\n' in the file from the end of it
+    size_t broadcast_file(std::string const& path) {
+        message m{nullptr};
+        m.file = file_payload::open(path);
+        if (m.file->size > UINT32_MAX)
+            throw std::length_error("broadcast_file: too large for a frame: " + path);
+
+        return for_each_active([&m](connection& c) { c.send(m); }); // line clients drop it when it comes up
+    }
+
+    message prepare(std::string msg, bool captured = true) { // the per-message work, before fan-out
+        if (_capture && captured)
+            _capture->broadcast(msg);
+        message m{std::make_shared<std::string const>(std::move(msg))};
+        if (_opts.compress) {
+            auto z = compression::deflate(*m.raw);
+            if (!z.empty())
+                m.deflated = std::make_shared<std::string const>(std::move(z));
+        }
+        if (_mcast)
+            _mcast->publish(m.raw);
+        if (_shm && !_shm->publish(*m.raw))
+            std::cout << "Broadcast too large for the shm ring (" << m.raw->size() << " bytes)" << std::endl;
+        return m;
+    }
+
+    void announce(std::string msg) { // the server's own, not captured: a replay makes them again
+        broadcast(prepare(std::move(msg), false));
+    }
+
+    void drain_ingress() { // on the io thread
+        static constexpr size_t max_batch = 256; // then let other handlers in
+
+        _ingress_posted.store(false); // publishers from here on post another drain
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        feed::batch batch;
+        for (std::string msg; batch.size() < max_batch && _ingress.pop(msg);)
+            batch.push_back(std::move(msg));
+        if (batch.size() == max_batch && !_ingress_posted.exchange(true))
+            post(_ioc, [this] { drain_ingress(); });
+        broadcast_batch(std::move(batch));
+    }
+
+    // one post per connection for the lot; at_front like broadcast(), or
+    // queued behind everything (the feed: bulk, strictly in order)
+    size_t broadcast_batch(std::vector<std::string> msgs, bool at_front = true) {
+        if (msgs.empty())
+            return 0;
+        if (at_front && msgs.size() == 1) // may take the io_uring fan-out
+            return broadcast(std::move(msgs.front()));
+
+        auto batch = std::make_shared<std::vector<message>>();
+        batch->reserve(msgs.size());
+        for (auto& msg : msgs)
+            batch->push_back(prepare(std::move(msg)));
+
+        std::shared_ptr<std::vector<message> const> shared = std::move(batch);
+        return for_each_active([&shared, at_front](connection& c) {
+            if (!c._via_multicast)
+                c.send_batch(shared, at_front);
+        });
+    }
+
+    size_t longest_queue() {
+        size_t longest = 0;
+        for_each_active([&longest](connection& c) { longest = std::max(longest, c._queued.load(std::memory_order_relaxed)); });
+        return longest;
+    }
+
+    // moves one connection from the busiest shard to the idlest, if that
+    // evens out their load since the last call; returns whether it did.
+    // Handler CPU is metered only with a rebalance period set, without one
+    // this goes by bytes alone
+    bool rebalance() {
+        std::map<ba::io_context*, uint64_t> load;
+        for (auto shard : _opts.shards)
+            load[shard] = 0;
+
+        std::vector<std::pair<connptr, uint64_t>> costs;
+        for_each_active([&](connection& c) {
+            // handler CPU misses the reactor's send/recv work, count bytes at ~1ns each
+            uint64_t total = c._cpu_ns + c._bytes;
+            uint64_t cost  = total - std::exchange(c._sampled, total);
+            load[c._home] += cost;
+            costs.emplace_back(c.ref(), cost);
+        });
+        if (load.size() < 2)
+            return false;
+
+        auto by_load = [](auto& a, auto& b) { return a.second < b.second; };
+        auto [cold, hot] = std::minmax_element(load.begin(), load.end(), by_load);
+        uint64_t gap = hot->second - cold->second;
+        if (gap * 4 < hot->second) // within 25%
+            return false;
+
+        connptr best;
+        uint64_t best_cost = 0;
+        for (auto& [c, cost] : costs) { // closest to half the gap, and actually narrowing it
+            if (c->_home != hot->first || !cost || cost >= gap)
+                continue;
+            auto miss = [gap](uint64_t v) { return v > gap / 2 ? v - gap / 2 : gap / 2 - v; };
+            if (!best || miss(cost) < miss(best_cost)) {
+                best      = c;
+                best_cost = cost;
+            }
+        }
+        if (!best)
+            return false;
+
+        if (s_verbose) std::cout << "Rebalancing " << best->peer() << " (" << best_cost << " of " << hot->second << ")" << std::endl;
+        std::shared_ptr<void> census;
+        for (auto& shard : _io_shards)
+            if (&shard->ioc == cold->first)
+                census = shard->census;
+        best->migrate(*cold->first, std::move(census)); // may decline, see migrate()
+        return true;
+    }
+
+    // a connection over an in-memory stream instead of a socket, on the io
+    // thread or a shard like an accepted one; returns the client's end.
+    // `to_client` paces what the client reads, see loopback.hpp.
+    loopback::stream connect_loopback(loopback::options to_client = {}, loopback::options to_server = {}) {
+        auto& home = _opts.shards.empty() ? _ioc : *_opts.shards[_accepted++ % _opts.shards.size()];
+        auto session = make_session<loopback::protocol>(home);
+        loopback::stream client(home);
+        connect(session->_s, client, to_client, to_server);
+        post(home, [this,session] {
+                auto n = reg_connection(*session);
+                session->configure();
+                session->start();
+                announce("player #" + std::to_string(n) + " has entered the game");
+            });
+        return client;
+    }
+
+    multicast::publisher* multicast() { return _mcast ? &*_mcast : nullptr; }
+    udp_fanout::sender*   udp_fanout() { return _udp ? &*_udp : nullptr; }
+    uring_fanout::engine* io_uring() { return _uring ? &*_uring : nullptr; }
+
+  private:
+    static server_options supported(server_options opts) { // by this build's connections
+        if (!policy::default_threading::concurrent && (opts.handlers || !opts.shards.empty() || opts.accept_thread)) {
+            std::cout << "Single-threaded build, ignoring handler pools, shards and the accept thread" << std::endl;
+            opts.handlers = nullptr;
+            opts.shards.clear();
+            opts.accept_thread = false;
+        }
+        return opts;
+    }
+
+    std::shared_ptr<registry> _registry = std::make_shared<registry>(); // connections may outlive the server
+
+    template <typename Protocol> boost::intrusive_ptr<basic_connection<Protocol>> make_session(ba::io_context& home) {
+        return boost::intrusive_ptr<basic_connection<Protocol>>(new basic_connection<Protocol>(*this, home, _opts));
+    }
+
+    size_t reg_connection(connection& c) {
+        if (_capture) {
+            c._capture    = _capture;
+            c._capture_id = ++_captured;
+            _capture->open(c._capture_id);
+        }
+        c._registry = _registry;
+        return _registry->add(c);
+    }
+
+    template <typename F>
+    size_t for_each_active(F f) {
+        auto active = _registry->active();
+        for (auto& c : active) {
+            if (s_verbose) std::cout << "(running action for " << c->peer() << ")" << std::endl;
+            f(*c);
+        }
+
+        return active.size();
+    }
+
+    void fan_out(message const& m, std::vector<connptr> const& recipients) {
+        using wire = connection::wire;
+        _uring->poll();
+        auto raw_hdr = framing::header{m.flags, uint32_t(m.raw->size())}.encode();
+        auto def_hdr = framing::header{framing::flag_deflate, uint32_t(m.deflated ? m.deflated->size() : 0)}.encode();
+        auto as_sv   = [](framing::header::bytes const& h) {
+            return std::string_view(reinterpret_cast<char const*>(h.data()), h.size());
+        };
+        std::string_view raw = *m.raw, deflated = m.deflated ? std::string_view(*m.deflated) : "";
+
+        std::array<std::size_t, 3> sizes{raw.size() + 1, framing::header_size + raw.size(),
+                                         framing::header_size + deflated.size()};
+        std::array<std::vector<uring_fanout::target>, 3> batches;
+        for (auto& c : recipients) {
+            if (auto claim = c->claim_direct(m)) {
+                auto size = sizes[size_t(claim->encoding)];
+                batches[size_t(claim->encoding)].push_back(
+                    {claim->fd, [c, size](int res) { c->direct_written(res, size); }});
+            }
+        }
+
+        auto submit = [this](std::initializer_list<std::string_view> parts, std::vector<uring_fanout::target>& batch) {
+            if (!batch.empty() && !_uring->submit(parts, batch))
+                for (auto& t : batch)
+                    t.done(-ECANCELED);
+        };
+        submit({raw, "\n"}, batches[size_t(wire::newline)]);
+        submit({as_sv(raw_hdr), raw}, batches[size_t(wire::binary)]);
+        submit({as_sv(def_hdr), deflated}, batches[size_t(wire::deflated)]);
+    }
+
+    void rebalance_loop() {
+        _rebalance_timer.expires_after(_opts.rebalance);
+        _rebalance_timer.async_wait([this](error_code ec) {
+                if (ec || _stopped) return;
+                rebalance();
+                rebalance_loop();
+            });
+    }
+
+    // with accept_thread, new sockets go to their I/O thread through a
+    // single-producer queue per shard; a drain is posted only when it was
+    // idle. The connection is constructed there, so that its memory is local
+    // to the thread (and NUMA node, see affinity.hpp) that uses it. Shards
+    // without an accept thread get the same: the socket is posted to its
+    // shard, round robin, and the connection constructed on arrival.
+    struct accepted {
+        int                   fd = -1;
+        int                   family = AF_UNSPEC;
+        std::shared_ptr<void> census; // counts towards the shard already
+    };
+
+    struct io_shard {
+        explicit io_shard(ba::io_context& ioc) : ioc(ioc), work(ioc.get_executor()) {}
+
+        ba::io_context&       ioc;
+        ba::executor_work_guard<ba::io_context::executor_type> work; // connections may still arrive
+        std::shared_ptr<void> census = std::make_shared<int>(); // use_count() - 1: its connections
+        std::atomic_bool      draining{false};
+        boost::lockfree::spsc_queue<accepted, boost::lockfree::capacity<1024>> handoff;
+    };
+
+    io_shard& least_loaded() {
+        auto by_census = [](auto& a, auto& b) { return a->census.use_count() < b->census.use_count(); };
+        return **std::min_element(_io_shards.begin(), _io_shards.end(), by_census);
+    }
+
+    void hand_off(io_shard& shard, accepted a) { // on the accept thread
+        if (!shard.handoff.push(a)) // full, during a storm
+            return post(shard.ioc, [this,&shard,a] { start_session(shard, a); });
+        if (!shard.draining.exchange(true))
+            post(shard.ioc, [this,&shard] {
+                    shard.draining = false; // anything pushed from here on gets another drain
+                    shard.handoff.consume_all([&](accepted const& a) { start_session(shard, a); });
+                });
+    }
+
+    void start_session(io_shard& shard, accepted const& a) { // on the shard's I/O thread
+        if (a.family == AF_UNIX)
+            start_session(shard, ba::local::stream_protocol(), a);
+        else
+            start_session(shard, a.family == AF_INET6 ? tcp::v6() : tcp::v4(), a);
+    }
+
+    template <typename Protocol> void start_session(io_shard& shard, Protocol proto, accepted const& a) {
+        auto session = make_session<Protocol>(shard.ioc);
+        error_code ec;
+        session->_s.assign(proto, a.fd, ec);
+        std::cout << "Accept from " << session->peer() << " (" << ec.message() << ")" << std::endl;
+        if (ec) {
+            ::close(a.fd);
+            return;
+        }
+
+        session->configure();
+        session->_census = a.census;
+        auto n = reg_connection(*session);
+        session->start();
+
+        announce("player #" + std::to_string(n) + " has entered the game");
+    }
+
+    template <typename Acceptor> void accept_loop(Acceptor& acc) {
+        using Protocol = typename Acceptor::protocol_type;
+        if (_accept_ioc) { // only accept here, the I/O thread takes it from there
+            acc.async_accept([this,&acc](error_code ec, typename Protocol::socket peer) {
+                    if (ec) {
+                        std::cout << "Accept (" << ec.message() << ")" << std::endl;
+                        return;
+                    }
+                    accept_loop(acc);
+
+                    auto& shard  = least_loaded();
+                    int   family = peer.local_endpoint(ec).protocol().family();
+                    int   fd     = peer.release(ec);
+                    if (!ec)
+                        hand_off(shard, {fd, family, shard.census});
+                });
+            return;
+        }
+
+        if (!_opts.shards.empty()) { // the socket for its shard, the connection built there
+            auto& home = *_opts.shards[_accepted++ % _opts.shards.size()];
+            using shard_socket = typename Protocol::socket::template rebind_executor<ba::io_context::executor_type>::other;
+            acc.async_accept(home, [this,&acc,&home](error_code ec, shard_socket peer) {
+                    if (ec) {
+                        std::cout << "Accept (" << ec.message() << ")" << std::endl;
+                        return;
+                    }
+                    accept_loop(acc);
+
+                    post(home, [this,&home,peer=std::move(peer)]() mutable {
+                            auto session = make_session<Protocol>(home);
+                            session->_s = std::move(peer);
+                            std::cout << "Accept from " << session->peer() << " (Success)" << std::endl;
+
+                            auto n = reg_connection(*session);
+                            session->configure();
+                            session->start();
+                            announce("player #" + std::to_string(n) + " has entered the game");
+                        });
+                });
+            return;
+        }
+
+        auto session = make_session<Protocol>(_ioc);
+        acc.async_accept(session->_s, [this,&acc,session](error_code ec) {
+             std::cout << "Accept from " << session->peer() << " (" << ec.message() << ")" << std::endl;
+
+             if (!ec) {
+                 auto n = reg_connection(*session);
+
+                 session->configure();
+                 session->start();
+                 accept_loop(acc);
+
+                 announce("player #" + std::to_string(n) + " has entered the game");
+             }
+        });
+    }
+
+    ba::io_context& _ioc;
+    server_options  _opts;
+    std::optional<multicast::publisher> _mcast;
+    std::optional<udp_fanout::sender>   _udp;
+    std::optional<shm_ring::writer>     _shm;
+    std::optional<uring_fanout::engine> _uring;
+    std::unique_ptr<ba::io_context> _accept_ioc = _opts.accept_thread ? std::make_unique<ba::io_context>(1) : nullptr;
+    tcp::acceptor _acc{_accept_ioc ? *_accept_ioc : _ioc, tcp::v4()};
+    std::optional<ba::local::stream_protocol::acceptor> _uds_acc;
+    std::atomic<size_t> _accepted{0};
+    std::vector<std::unique_ptr<io_shard>> _io_shards;
+    std::thread _accept_thread;
+    ba::steady_timer _rebalance_timer{_ioc};
+    bool _stopped = false;
+    mpmc::queue<std::string> _ingress{_opts.ingress_capacity};
+    std::atomic_bool _ingress_posted{false};
+    std::optional<feed::source> _feed;
+    std::shared_ptr<capture::writer> _capture; // connections may outlive the server
+    std::atomic<uint64_t> _captured{0};
+};
+
+template <typename Protocol, typename Framing, template <typename...> class TxQueue, typename Threading, typename Logging>
+void basic_connection<Protocol, Framing, TxQueue, Threading, Logging>::on_command(std::string const& cmd) {
+    std::istringstream iss(cmd.substr(1));
+    std::string verb;
+    iss >> verb;
+
+    auto mcast = _server.multicast();
+    auto udp   = _server.udp_fanout();
+    if (verb == "mcast" && mcast) { // switch broadcast delivery to multicast
+        _via_multicast = true;
+        auto group = mcast->group();
+        send("!mcast " + group.address().to_string() + " " + std::to_string(group.port()) + " " +
+             std::to_string(mcast->next_seq()));
+    } else if (uint64_t from, to; verb == "nack" && mcast && iss >> from >> to) { // [from, to)
+        mcast->replay(from, to, [this](uint64_t seq, payload const& msg) { send_repair(seq, msg); });
+    } else if (unsigned short port; verb == "udp" && udp && iss >> port) { // state updates to port
+        ba::ip::address addr = ba::ip::address_v4::loopback(); // same host for AF_UNIX and in-memory
+        error_code ec;
+        if constexpr (std::is_same_v<Protocol, tcp>)
+            addr = _s.remote_endpoint(ec).address();
+        if (!ec) {
+            udp->subscribe({addr, port}, [reg = _registry, id = _id] { return reg->alive(id); });
+            _via_udp = true;
+        }
+    } else {
+        send(cmd); // echo
+    }
+}
+
+template <typename Protocol, typename Framing, template <typename...> class TxQueue, typename Threading, typename Logging>
+void basic_connection<Protocol, Framing, TxQueue, Threading, Logging>::send_repair(uint64_t seq, payload const& msg) {
+    std::string repair;
+    if (mode() == framing::mode::length_prefixed) { // seq:64 big-endian, payload
+        repair.resize(multicast::seq_size);
+        multicast::put_seq(reinterpret_cast<uint8_t*>(&repair[0]), seq);
+        repair += *msg;
+    } else {
+        repair = "!repair " + std::to_string(seq) + " " + *msg;
+    }
+
+    message m{std::make_shared<std::string const>(std::move(repair))};
+    if (mode() == framing::mode::length_prefixed)
+        m.flags = framing::flag_repair;
+    send(std::move(m));
+}
@@ -0,0 +1,24 @@
+// Prints broadcasts from the server's shared-memory ring (./test -S /broadcast).
+//
+//  g++ -std=c++17 -O2 shm_reader.cpp -o shm_reader
+#include "shm_ring.hpp"
+#include <iostream>
+#include <sched.h>
+
+int main(int argc, char** argv) {
+    shm_ring::reader ring(argc > 1 ? argv[1] : "/broadcast");
+
+    for (std::string msg;;) {
+        switch (ring.read(msg)) {
+            case shm_ring::reader::status::ok:
+                std::cout << "#" << ring.next() - 1 << ": " << msg << std::endl;
+                break;
+            case shm_ring::reader::status::lapped:
+                std::cout << "(lapped, " << ring.lost() << " lost so far)" << std::endl;
+                break;
+            case shm_ring::reader::status::empty:
+                ::sched_yield(); // or spin, when a core is dedicated to us
+                break;
+        }
+    }
+}
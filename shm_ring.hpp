@@ -0,0 +1,186 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Shared-memory broadcast ring for co-located subscriber processes (POSIX shm).
+//
+// The writer copies each message once into a fixed-size slot; any number of
+// reader processes map the same segment read-only and poll it, without a
+// syscall per message. Each slot is a seqlock: `seq` is 2n+1 while message n
+// is being written and 2n+2 once it's complete, so a reader that gets lapped
+// (the writer reused the slot) notices, reports how much it lost and resyncs
+// to the oldest message still available.
+//
+// Link with -lrt on older glibc.
+namespace shm_ring {
+    static constexpr uint64_t magic       = 0x6263'6173'7472'6731; // "bcastrg1"
+    static constexpr size_t   slot_header = 16;                    // seq:64, size:32, pad
+
+    struct header {
+        uint64_t magic;
+        uint32_t capacity;  // slots, a power of two
+        uint32_t slot_size; // bytes, including slot_header
+        alignas(64) std::atomic<uint64_t> head; // next message number to be written
+    };
+
+    static constexpr size_t slots_offset = (sizeof(header) + 63) & ~size_t(63);
+
+    namespace detail {
+        struct mapping {
+            mapping(std::string const& name, bool create, size_t size = 0) {
+                int fd = create ? ::shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644)
+                                : ::shm_open(name.c_str(), O_RDONLY, 0);
+                if (fd < 0)
+                    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+
+                struct stat st;
+                if ((create && ::ftruncate(fd, size)) || ::fstat(fd, &st)) {
+                    int e = errno;
+                    ::close(fd);
+                    throw std::system_error(e, std::generic_category(), "shm size " + name);
+                }
+
+                _size = st.st_size;
+                _base = ::mmap(nullptr, _size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (_base == MAP_FAILED)
+                    throw std::system_error(errno, std::generic_category(), "mmap " + name);
+            }
+
+            ~mapping() { ::munmap(_base, _size); }
+            mapping(mapping const&) = delete;
+            mapping& operator=(mapping const&) = delete;
+
+            char*  base() const { return static_cast<char*>(_base); }
+            size_t size() const { return _size; }
+
+          private:
+            void*  _base;
+            size_t _size;
+        };
+
+        inline std::atomic<uint64_t>& slot_seq(char* slot) { return *reinterpret_cast<std::atomic<uint64_t>*>(slot); }
+        inline uint32_t& slot_size(char* slot) { return *reinterpret_cast<uint32_t*>(slot + 8); }
+    }
+
+    struct writer {
+        explicit writer(std::string name, uint32_t capacity = 16384, uint32_t slot_size = 1024)
+            : _name(std::move(name)), _map(_name, true, mapped_size(capacity, slot_size)) {
+            _hdr = new (_map.base()) header{magic, capacity, slot_size, {0}};
+            for (uint32_t i = 0; i < capacity; ++i)
+                new (slot(i)) std::atomic<uint64_t>(0);
+        }
+
+        ~writer() { ::shm_unlink(_name.c_str()); } // mapped readers keep their view
+
+        size_t max_message() const { return _hdr->slot_size - slot_header; }
+
+        bool publish(std::string_view msg) { // false if the message doesn't fit a slot
+            if (msg.size() > max_message())
+                return false;
+
+            std::lock_guard<std::mutex> lk(_mx);
+            uint64_t n = _hdr->head.load(std::memory_order_relaxed);
+            char*    s = slot(n);
+
+            auto& seq = detail::slot_seq(s);
+            seq.store(2 * n + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            detail::slot_size(s) = msg.size();
+            std::memcpy(s + slot_header, msg.data(), msg.size());
+            seq.store(2 * n + 2, std::memory_order_release);
+
+            _hdr->head.store(n + 1, std::memory_order_release);
+            return true;
+        }
+
+      private:
+        // before the segment is created: bad arguments leave nothing behind
+        static size_t mapped_size(uint32_t capacity, uint32_t slot_size) {
+            if (!capacity || capacity & (capacity - 1) || slot_size <= slot_header || slot_size % 64)
+                throw std::invalid_argument("shm_ring: capacity must be a power of two, slot_size a multiple of 64");
+            return slots_offset + size_t(capacity) * slot_size;
+        }
+
+        char* slot(uint64_t n) const {
+            return _map.base() + slots_offset + (n & (_hdr->capacity - 1)) * _hdr->slot_size;
+        }
+
+        std::string     _name;
+        detail::mapping _map;
+        header*         _hdr;
+        std::mutex      _mx; // publish may be called from several threads
+    };
+
+    struct reader {
+        enum class status { ok, empty, lapped };
+
+        explicit reader(std::string const& name) : _map(name, false) {
+            _hdr = reinterpret_cast<header const*>(_map.base());
+            if (_map.size() < sizeof(header) || _hdr->magic != magic)
+                throw std::runtime_error("shm_ring: not a broadcast ring: " + name);
+            _next = _hdr->head.load(std::memory_order_acquire); // new messages only
+        }
+
+        // `out` is only valid when status::ok; after status::lapped, lost()
+        // has grown and the next read continues at the oldest retained message
+        status read(std::string& out) {
+            uint64_t head = _hdr->head.load(std::memory_order_acquire);
+            if (_next >= head)
+                return status::empty;
+            if (head - _next > _hdr->capacity)
+                return resync(head);
+
+            char* s    = slot(_next);
+            auto& seq  = detail::slot_seq(s);
+            auto  want = 2 * _next + 2;
+            if (seq.load(std::memory_order_acquire) != want)
+                return resync(head);
+
+            uint32_t size = detail::slot_size(s);
+            if (size > _hdr->slot_size - slot_header)
+                return resync(head);
+            out.assign(s + slot_header, size);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) != want)
+                return resync(_hdr->head.load(std::memory_order_acquire));
+
+            ++_next;
+            return status::ok;
+        }
+
+        uint64_t next() const { return _next; }
+        uint64_t lost() const { return _lost; }
+
+      private:
+        status resync(uint64_t head) {
+            // skip ahead past what the writer may be overwriting right now
+            uint64_t oldest = head > _hdr->capacity ? head - _hdr->capacity + 1 : 0;
+            oldest = std::max(oldest, _next + 1);
+            _lost += oldest - _next;
+            _next = oldest;
+            return status::lapped;
+        }
+
+        char* slot(uint64_t n) const {
+            return _map.base() + slots_offset + (n & (_hdr->capacity - 1)) * _hdr->slot_size;
+        }
+
+        detail::mapping _map;
+        header const*   _hdr;
+        uint64_t        _next = 0;
+        uint64_t        _lost = 0;
+    };
+}
@@ -1,117 +1,107 @@
-#include <boost/asio.hpp>
-#include <memory>
-#include <list>
-#include <iostream>
-
-namespace ba = boost::asio;
-using ba::ip::tcp;
-using boost::system::error_code;
+#include "server.hpp"
+#include <thread>
+
 using namespace std::chrono_literals;
 using namespace std::string_literals;
 
-static bool s_verbose = false;
-
-struct connection : std::enable_shared_from_this<connection> {
-    connection(ba::io_context& ioc) : _s(ioc) {}
-
-    void start() { read_loop(); }
-    void send(std::string msg, bool at_front = false) {
-        post(_s.get_io_service(), [=] { // _s.get_executor() for newest Asio
-            if (enqueue(std::move(msg), at_front))
-                write_loop();
-        });
-    }
-
-  private:
-    void do_echo() {
-        std::string line;
-        if (getline(std::istream(&_rx), line)) {
-            send(std::move(line) + '\n');
+int main(int argc, char** argv) {
+    server_options opts;
+    std::string asset; // broadcast from file
+    size_t handler_threads = 0, n_shards = 0, producers = 0;
+    affinity::cpus io_cpus; // dealt to the io thread, then the shards
+    std::chrono::microseconds spin{0}; // busy-poll the io threads this long before blocking
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i < args.size(); ++i) {
+        auto& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        if      (arg == "-v") s_verbose = true;
+        else if (arg == "-z") opts.compress = true;
+        else if (arg == "-b") opts.framing = framing::mode::length_prefixed;
+        else if (arg == "-n") opts.framing = framing::mode::newline;
+        else if (arg == "-u") opts.udp_state = true;
+        else if (arg == "-i") opts.io_uring = true;
+        else if (arg == "-a") opts.accept_thread = true;
+        else if (arg == "-U" && has_value) opts.unix_path = args[++i];
+        else if (arg == "-S" && has_value) opts.shm_ring = args[++i];
+        else if (arg == "-F" && has_value) asset = args[++i];
+        else if (arg == "-I" && has_value) opts.feed = args[++i]; // - for stdin
+        else if (arg == "-c" && has_value) opts.capture = args[++i];
+        else if (arg == "-Z" && has_value) opts.zerocopy_threshold = std::stoul(args[++i]);
+        else if (arg == "-t" && has_value) handler_threads = std::stoul(args[++i]);
+        else if (arg == "-s" && has_value) n_shards = std::stoul(args[++i]);
+        else if (arg == "-p" && has_value) producers = std::stoul(args[++i]);
+        else if (arg == "-C" && has_value) io_cpus = affinity::parse(args[++i]);
+        else if (arg == "-A" && has_value) opts.accept_cpus = affinity::parse(args[++i]);
+        else if (arg == "-B" && has_value) opts.busy_poll = spin = std::chrono::microseconds(std::stoul(args[++i]));
+        else if (arg == "-m" && has_value) { // -m 239.255.0.1:6768
+            auto& v = args[++i];
+            auto colon = v.rfind(':');
+            opts.multicast.emplace(ba::ip::make_address(v.substr(0, colon)),
+                                   std::stoi(v.substr(colon + 1)));
         }
     }
 
-    bool enqueue(std::string msg, bool at_front)
-    { // returns true if need to start write loop
-        at_front &= !_tx.empty(); // no difference
-        if (at_front)
-            _tx.insert(std::next(begin(_tx)), std::move(msg));
-        else
-            _tx.push_back(std::move(msg));
-
-        return (_tx.size() == 1);
-    }
-    bool dequeue()
-    { // returns true if more messages pending after dequeue
-        assert(!_tx.empty());
-        _tx.pop_front();
-        return !_tx.empty();
-    }
-
-    void write_loop() {
-        ba::async_write(_s, ba::buffer(_tx.front()), [this,self=shared_from_this()](error_code ec, size_t n) {
-                if (s_verbose) std::cout << "Tx: " << n << " bytes (" << ec.message() << ")" << std::endl;
-                if (!ec && dequeue()) write_loop();
-            });
-    }
-
-    void read_loop() {
-        ba::async_read_until(_s, _rx, "\n", [this,self=shared_from_this()](error_code ec, size_t n) {
-                if (s_verbose) std::cout << "Rx: " << n << " bytes (" << ec.message() << ")" << std::endl;
-                do_echo();
-                if (!ec)
-                    read_loop();
-            });
+    std::optional<work_stealing::pool> handlers; // outlives the io_context and its handlers
+    if (handler_threads)
+        opts.handlers = &handlers.emplace(handler_threads);
+
+    std::vector<std::unique_ptr<ba::io_context>> shards; // one io_context per thread
+    std::vector<ba::executor_work_guard<ba::io_context::executor_type>> shard_work;
+    std::vector<std::thread> shard_threads;
+    for (size_t i = 0; i < n_shards; ++i) {
+        auto& shard = *shards.emplace_back(std::make_unique<ba::io_context>(1));
+        shard_work.push_back(make_work_guard(shard));
+        shard_threads.emplace_back([&shard, spin, cpus = affinity::nth(io_cpus, i + 1)] {
+            affinity::pin_this_thread(cpus);
+            busy_poll::run(shard, spin);
+        });
+        opts.shards.push_back(&shard);
     }
+    if (!shards.empty())
+        opts.rebalance = 1s;
 
-    friend struct server;
-    ba::streambuf          _rx;
-    std::list<std::string> _tx;
-    tcp::socket            _s;
-};
-
-struct server {
-    server(ba::io_context& ioc) : _ioc(ioc) {
-        _acc.bind({{}, 6767});
-        _acc.set_option(tcp::acceptor::reuse_address());
-        _acc.listen();
-        accept_loop();
-    }
+    ba::io_context ioc;
 
-    void stop() {
-        _ioc.post([=] {
-                _acc.cancel();
-                _acc.close();
-            });
-    }
+    server s(ioc, opts);
 
-  private:
-    void accept_loop() {
-        auto session = std::make_shared<connection>(_acc.get_io_context());
-        _acc.async_accept(session->_s, [this,session](error_code ec) {
-             auto ep = ec? tcp::endpoint{} : session->_s.remote_endpoint();
-             std::cout << "Accept from " << ep << " (" << ec.message() << ")" << std::endl;
+    std::thread th([&ioc, spin, cpus = affinity::nth(io_cpus, 0)] { // todo exception handling
+        affinity::pin_this_thread(cpus);
+        busy_poll::run(ioc, spin);
+    });
 
-             session->start();
-             if (!ec)
-                 accept_loop();
-        });
-    }
+    std::this_thread::sleep_for(1s);
 
-    ba::io_context& _ioc;
-    tcp::acceptor _acc{_ioc, tcp::v4()};
-};
+    // on the io thread: a single-threaded build's connections count references without atomics
+    auto on_io = [&ioc](auto f) { return ba::post(ioc, ba::use_future(std::move(f))).get(); };
 
-int main(int argc, char** argv) {
-    s_verbose = argc>1 && argv[1] == "-v"s;
+    auto n = on_io([&s] { return s.broadcast("random global event broadcast"); });
+    std::cout << "Global event broadcast reached " << n << " active connections\n";
 
-    ba::io_context ioc;
+    n = on_io([&s] { return s.broadcast_state("state tick"); });
+    std::cout << "State update reached " << n << " subscribers\n";
 
-    server s(ioc);
+    if (!asset.empty()) {
+        n = on_io([&s, &asset] { return s.broadcast_file(asset); });
+        std::cout << "Asset " << asset << " queued for " << n << " active connections\n";
+    }
 
-    std::thread th([&ioc] { ioc.run(); }); // todo exception handling
+    std::vector<std::thread> game_logic; // producers that must never wait on I/O
+    for (size_t i = 0; i < producers; ++i)
+        game_logic.emplace_back([&s, i] {
+            for (int tick = 0; tick < 3; ++tick)
+                if (!s.publish("event " + std::to_string(tick) + " from game logic #" + std::to_string(i)))
+                    std::cout << "Ingress full, event dropped\n";
+        });
+    for (auto& t : game_logic)
+        t.join();
 
-    std::this_thread::sleep_for(3s);
+    std::this_thread::sleep_for(2s);
     s.stop(); // active connections will continue
 
     th.join();
+
+    shard_work.clear(); // shards run until their connections are gone
+    for (auto& t : shard_threads)
+        t.join();
 }
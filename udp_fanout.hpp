@@ -0,0 +1,168 @@
+#pragma once
+#include "multicast.hpp" // datagram format: seq:64 big-endian, payload
+#include <boost/asio.hpp>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Unreliable UDP unicast fan-out for state updates (Linux).
+//
+// One broadcast goes to all subscribed endpoints in batches of up to
+// max_batch datagrams per sendmmsg. When a tick carries several equally
+// sized messages, each endpoint gets them in a single UDP_SEGMENT (GSO)
+// super-datagram that the kernel splits, so the syscall count is
+// ceil(endpoints / max_batch) either way.
+//
+// Nothing is retried: a full socket buffer just drops datagrams.
+namespace udp_fanout {
+    namespace ba = boost::asio;
+    using ba::ip::udp;
+    using payload = std::shared_ptr<std::string const>;
+
+    static constexpr size_t max_batch    = 1024; // UIO_MAXIOV
+    static constexpr size_t max_segments = 64;   // UDP_MAX_SEGMENTS
+    static constexpr size_t max_gso_size = 65000;
+
+    struct stats {
+        size_t syscalls = 0, datagrams = 0, dropped = 0;
+    };
+
+    struct sender {
+        explicit sender(ba::io_context& ioc, bool gso = true) : _gso(gso), _s(ioc, udp::v4()) {
+            _s.non_blocking(true);
+        }
+
+        // the subscription ends once `alive` returns false
+        void subscribe(udp::endpoint ep, std::function<bool()> alive) {
+            std::lock_guard<std::mutex> lk(_mx);
+            _subscribers.push_back({ep, std::move(alive)});
+        }
+
+        size_t send(payload msg) { return send(std::vector<payload>{std::move(msg)}); }
+
+        size_t send(std::vector<payload> const& tick) { // returns endpoints reached
+            std::lock_guard<std::mutex> lk(_mx);
+            prune();
+            if (tick.empty() || _subscribers.empty())
+                return 0;
+
+            _seq.resize(tick.size() * multicast::seq_size);
+            _iov.clear();
+            for (size_t i = 0; i < tick.size(); ++i) {
+                auto hdr = &_seq[i * multicast::seq_size];
+                multicast::put_seq(hdr, _next_seq++);
+                _iov.push_back({hdr, multicast::seq_size});
+                _iov.push_back({const_cast<char*>(tick[i]->data()), tick[i]->size()});
+            }
+
+            if (_gso && gso_applies(tick) && send_all(tick.size(), true))
+                return _subscribers.size();
+
+            send_all(tick.size(), false);
+            return _subscribers.size();
+        }
+
+        stats get_stats() {
+            std::lock_guard<std::mutex> lk(_mx);
+            return _stats;
+        }
+
+      private:
+        struct subscriber {
+            udp::endpoint         ep;
+            std::function<bool()> alive;
+        };
+
+        void prune() {
+            _subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(),
+                                              [](subscriber const& s) { return !s.alive(); }),
+                               _subscribers.end());
+        }
+
+        static bool gso_applies(std::vector<payload> const& tick) {
+            // all segments the same size, except that the last may be shorter
+            if (tick.size() < 2 || tick.size() > max_segments)
+                return false;
+            size_t seg = tick.front()->size(), total = 0;
+            for (auto& m : tick) {
+                if (m->size() > seg || (m->size() != seg && &m != &tick.back()))
+                    return false;
+                total += multicast::seq_size + m->size();
+            }
+            return total <= max_gso_size;
+        }
+
+        // returns false only if the kernel rejects GSO, which disables it
+        bool send_all(size_t n_msgs, bool gso) {
+            size_t per_ep = gso ? 1 : n_msgs;
+            _hdrs.resize(_subscribers.size() * per_ep);
+
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+            if (gso) {
+                auto cm        = reinterpret_cast<cmsghdr*>(control);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type  = UDP_SEGMENT;
+                cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+                uint16_t seg   = multicast::seq_size + _iov[1].iov_len;
+                std::memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+            }
+
+            auto h = _hdrs.data();
+            for (auto& sub : _subscribers) {
+                for (size_t i = 0; i < per_ep; ++i, ++h) {
+                    *h = mmsghdr{};
+                    h->msg_hdr.msg_name    = sub.ep.data();
+                    h->msg_hdr.msg_namelen = sub.ep.size();
+                    h->msg_hdr.msg_iov     = &_iov[gso ? 0 : 2 * i];
+                    h->msg_hdr.msg_iovlen  = gso ? _iov.size() : 2;
+                    if (gso) { // shared, the kernel only reads it
+                        h->msg_hdr.msg_control    = control;
+                        h->msg_hdr.msg_controllen = sizeof(control);
+                    }
+                }
+            }
+
+            int fd = _s.native_handle();
+            for (size_t done = 0; done < _hdrs.size();) {
+                auto chunk = std::min(max_batch, _hdrs.size() - done);
+                int  r     = ::sendmmsg(fd, &_hdrs[done], chunk, 0);
+                ++_stats.syscalls;
+                if (r < 0) {
+                    if (gso && done == 0 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                        _gso = false; // no UDP GSO here (kernel/NIC), resend without
+                        return false;
+                    }
+                    size_t per_hdr = gso ? n_msgs : 1;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                        // the socket buffer is full, retrying now only fails again: drop the rest
+                        _stats.dropped += (_hdrs.size() - done) * per_hdr;
+                        return true;
+                    }
+                    r = 1; // skip the offending datagram: that destination's error
+                    _stats.dropped += per_hdr;
+                } else {
+                    _stats.datagrams += r * (gso ? n_msgs : 1);
+                }
+                done += r;
+            }
+            return true;
+        }
+
+        bool                     _gso;
+        std::mutex               _mx;
+        uint64_t                 _next_seq = 0;
+        std::vector<subscriber>  _subscribers;
+        std::vector<uint8_t>     _seq;
+        std::vector<iovec>       _iov;
+        std::vector<mmsghdr>     _hdrs;
+        stats                    _stats;
+        udp::socket              _s;
+    };
+}
@@ -0,0 +1,289 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Broadcast fan-out through io_uring (Linux >= 5.6), without liburing.
+//
+// A broadcast is copied once into a slot of a registered (pinned) buffer
+// arena, then one IORING_OP_WRITE_FIXED per recipient socket is queued and
+// the whole batch goes to the kernel with a single io_uring_enter. The slot
+// is reused once every write has completed. Completions are signalled on an
+// eventfd that the io_context watches while writes are outstanding.
+//
+// The engine isn't thread-safe: submit from the io_context's thread, which is
+// where the completion handlers run too. The constructor throws if the kernel
+// (or a seccomp policy) doesn't allow io_uring; callers fall back to Asio.
+namespace uring_fanout {
+    namespace ba = boost::asio;
+
+    namespace detail {
+        inline int setup(unsigned entries, io_uring_params& p) {
+            return int(::syscall(__NR_io_uring_setup, entries, &p));
+        }
+        inline int enter(int fd, unsigned to_submit) {
+            return int(::syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, nullptr, 0));
+        }
+        inline int reg(int fd, unsigned op, void const* arg, unsigned n) {
+            return int(::syscall(__NR_io_uring_register, fd, op, arg, n));
+        }
+        inline void check(bool ok, char const* what) {
+            if (!ok)
+                throw std::system_error(errno, std::generic_category(), what);
+        }
+        template <typename T> std::atomic<T>& shared(void* base, unsigned off) {
+            return *reinterpret_cast<std::atomic<T>*>(static_cast<char*>(base) + off);
+        }
+
+        // the submission and completion rings, mapped from the kernel
+        struct ring {
+            explicit ring(unsigned entries) {
+                io_uring_params p{};
+                _fd = setup(entries, p);
+                check(_fd >= 0, "io_uring_setup");
+
+                _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+                if (p.features & IORING_FEAT_SINGLE_MMAP)
+                    _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+
+                _sq = map(_sq_size, IORING_OFF_SQ_RING);
+                _cq = (p.features & IORING_FEAT_SINGLE_MMAP) ? _sq : map(_cq_size, IORING_OFF_CQ_RING);
+                _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+                _sqes = static_cast<io_uring_sqe*>(map(_sqes_size, IORING_OFF_SQES));
+
+                _sq_off = p.sq_off;
+                _cq_off = p.cq_off;
+                _sq_entries = p.sq_entries;
+                _cq_entries = p.cq_entries;
+
+                auto array = reinterpret_cast<unsigned*>(static_cast<char*>(_sq) + _sq_off.array);
+                for (unsigned i = 0; i < _sq_entries; ++i)
+                    array[i] = i; // sqe i always sits in slot i
+                _tail = shared<unsigned>(_sq, _sq_off.tail).load(std::memory_order_relaxed);
+            }
+
+            ~ring() {
+                ::munmap(_sqes, _sqes_size);
+                if (_cq != _sq)
+                    ::munmap(_cq, _cq_size);
+                ::munmap(_sq, _sq_size);
+                ::close(_fd);
+            }
+            ring(ring const&) = delete;
+            ring& operator=(ring const&) = delete;
+
+            int      fd() const { return _fd; }
+            unsigned cq_entries() const { return _cq_entries; }
+
+            io_uring_sqe* get_sqe() { // nullptr when the submission queue is full
+                auto head = shared<unsigned>(_sq, _sq_off.head).load(std::memory_order_acquire);
+                if (_tail - head >= _sq_entries)
+                    return nullptr;
+                auto sqe = &_sqes[_tail++ & (_sq_entries - 1)];
+                std::memset(sqe, 0, sizeof(*sqe));
+                return sqe;
+            }
+
+            int submit() { // returns the number of entries the kernel consumed
+                shared<unsigned>(_sq, _sq_off.tail).store(_tail, std::memory_order_release);
+                unsigned pending = _tail - _submitted;
+                int n = 0;
+                do n = enter(_fd, pending);
+                while (n < 0 && errno == EINTR);
+                check(n >= 0, "io_uring_enter");
+                _submitted += n;
+                return n;
+            }
+
+            template <typename F> void reap(F f) {
+                auto& head = shared<unsigned>(_cq, _cq_off.head);
+                auto  tail = shared<unsigned>(_cq, _cq_off.tail).load(std::memory_order_acquire);
+                auto  cqes = reinterpret_cast<io_uring_cqe const*>(static_cast<char*>(_cq) + _cq_off.cqes);
+                auto  h    = head.load(std::memory_order_relaxed);
+                for (; h != tail; ++h)
+                    f(cqes[h & (_cq_entries - 1)]);
+                head.store(h, std::memory_order_release);
+            }
+
+          private:
+            void* map(size_t size, off_t what) {
+                auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, what);
+                check(p != MAP_FAILED, "io_uring mmap");
+                return p;
+            }
+
+            int                    _fd;
+            void*                  _sq;
+            void*                  _cq;
+            io_uring_sqe*          _sqes;
+            size_t                 _sq_size, _cq_size, _sqes_size;
+            io_sqring_offsets      _sq_off;
+            io_cqring_offsets      _cq_off;
+            unsigned               _sq_entries, _cq_entries;
+            unsigned               _tail, _submitted = 0;
+        };
+    }
+
+    struct target {
+        int                      fd;
+        std::function<void(int)> done; // bytes written or -errno, like the CQE
+    };
+
+    struct stats {
+        size_t syscalls = 0, writes = 0, rejected = 0;
+    };
+
+    struct engine {
+        explicit engine(ba::io_context& ioc, unsigned entries = 4096, size_t slots = 64, size_t slot_size = 64 << 10)
+            : _ring(entries), _slot_size(slot_size), _slot_refs(slots), _efd(ioc) {
+            int efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            detail::check(efd >= 0, "eventfd");
+            _efd.assign(efd);
+            detail::check(detail::reg(_ring.fd(), IORING_REGISTER_EVENTFD, &efd, 1) >= 0, "IORING_REGISTER_EVENTFD");
+
+            _arena_size = slots * slot_size;
+            _arena = static_cast<char*>(::mmap(nullptr, _arena_size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            detail::check(_arena != MAP_FAILED, "mmap arena");
+
+            iovec iov{_arena, _arena_size};
+            if (detail::reg(_ring.fd(), IORING_REGISTER_BUFFERS, &iov, 1) < 0) { // RLIMIT_MEMLOCK, mostly
+                int e = errno;
+                ::munmap(_arena, _arena_size);
+                throw std::system_error(e, std::generic_category(), "IORING_REGISTER_BUFFERS");
+            }
+
+            for (size_t i = slots; i--;)
+                _free_slots.push_back(i);
+        }
+
+        ~engine() { ::munmap(_arena, _arena_size); } // the ring keeps its own page references until closed
+        engine(engine const&) = delete;
+        engine& operator=(engine const&) = delete;
+
+        size_t max_frame() const { return _slot_size; }
+
+        // writes the concatenated parts to every target with one syscall (more
+        // only for batches beyond the queue size); returns false without side
+        // effects when it can't take the frame right now
+        bool submit(std::initializer_list<std::string_view> parts, std::vector<target>& targets) {
+            size_t size = 0;
+            for (auto p : parts)
+                size += p.size();
+            if (targets.empty() || size > _slot_size || size > UINT32_MAX || _free_slots.empty() ||
+                _outstanding + targets.size() > _ring.cq_entries()) {
+                ++_stats.rejected;
+                return false;
+            }
+
+            auto slot = _free_slots.back();
+            _free_slots.pop_back();
+            char* frame = _arena + slot * _slot_size;
+            size_t off = 0;
+            for (auto p : parts) {
+                std::memcpy(frame + off, p.data(), p.size());
+                off += p.size();
+            }
+            _slot_refs[slot] = targets.size();
+
+            for (auto& t : targets) {
+                auto sqe = _ring.get_sqe();
+                if (!sqe) { // more recipients than queue entries
+                    _ring.submit();
+                    ++_stats.syscalls;
+                    sqe = _ring.get_sqe();
+                }
+                sqe->opcode    = IORING_OP_WRITE_FIXED;
+                sqe->fd        = t.fd;
+                sqe->addr      = reinterpret_cast<uintptr_t>(frame);
+                sqe->len       = size;
+                sqe->buf_index = 0;
+                sqe->user_data = new_op(slot, std::move(t.done));
+            }
+            _ring.submit();
+            ++_stats.syscalls;
+            _stats.writes += targets.size();
+            _outstanding += targets.size();
+
+            watch();
+            return true;
+        }
+
+        stats get_stats() const { return _stats; }
+
+        // runs the handlers of writes that already completed, so that their
+        // connections are idle again before the next batch
+        void poll() { on_completions(); }
+
+      private:
+        struct op {
+            size_t                   slot;
+            std::function<void(int)> done;
+        };
+
+        uint64_t new_op(size_t slot, std::function<void(int)> done) {
+            if (_free_ops.empty()) {
+                _ops.push_back({slot, std::move(done)});
+                return _ops.size() - 1;
+            }
+            auto i = _free_ops.back();
+            _free_ops.pop_back();
+            _ops[i] = {slot, std::move(done)};
+            return i;
+        }
+
+        void watch() { // the eventfd keeps the io_context busy only while writes are outstanding
+            if (_watching || !_outstanding)
+                return;
+            _watching = true;
+            _efd.async_read_some(ba::buffer(&_efd_count, sizeof(_efd_count)), [this](boost::system::error_code ec, size_t) {
+                    _watching = false;
+                    if (ec) return;
+                    on_completions();
+                    watch();
+                });
+        }
+
+        void on_completions() {
+            _completed.clear();
+            _ring.reap([this](io_uring_cqe const& cqe) {
+                auto& o = _ops[cqe.user_data];
+                if (--_slot_refs[o.slot] == 0)
+                    _free_slots.push_back(o.slot);
+                _completed.emplace_back(std::move(o.done), cqe.res);
+                _free_ops.push_back(cqe.user_data);
+                --_outstanding;
+            });
+
+            for (auto& [done, res] : _completed) // handlers may submit again
+                done(res);
+        }
+
+        detail::ring        _ring;
+        char*               _arena;
+        size_t              _arena_size, _slot_size;
+        std::vector<size_t> _slot_refs, _free_slots;
+        std::vector<op>     _ops;
+        std::vector<size_t> _free_ops;
+        size_t              _outstanding = 0;
+        std::vector<std::pair<std::function<void(int)>, int>> _completed;
+
+        ba::posix::stream_descriptor _efd;
+        uint64_t                     _efd_count;
+        bool                         _watching = false;
+        stats                        _stats;
+    };
+}
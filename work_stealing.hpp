@@ -0,0 +1,184 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool usable as an Asio executor.
+//
+// Every worker has its own deque: handlers posted from a worker go to the
+// back of its own deque and it pops from the back (hot caches, LIFO), while
+// idle workers steal from the front of the others'. Posts from outside the
+// pool (e.g. completions from the io_context's reactor thread) are spread
+// round-robin.
+//
+// Nothing is ordered across handlers: wrap the executor in a ba::strand per
+// connection, and bind its completion handlers to that with bind_executor.
+// Whichever worker picks up the strand then runs its handlers in order.
+namespace work_stealing {
+    namespace ba = boost::asio;
+
+    struct stats {
+        size_t executed = 0, stolen = 0;
+    };
+
+    struct pool : ba::execution_context {
+        struct executor_type;
+
+        explicit pool(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+            : _workers(threads) {
+            for (auto& w : _workers)
+                w = std::make_unique<worker>();
+            for (size_t i = 0; i < threads; ++i)
+                _threads.emplace_back([this, i] { run(i); });
+        }
+
+        ~pool() {
+            stop();
+            for (auto& th : _threads)
+                th.join();
+            for (auto& w : _workers) // pending handlers may reference strands, i.e. services
+                w->q.clear();
+            shutdown();
+            destroy();
+        }
+
+        executor_type get_executor() noexcept;
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lk(_idle_mx);
+                _stopped = true;
+            }
+            _idle_cv.notify_all();
+        }
+
+        size_t size() const { return _workers.size(); }
+
+        stats get_stats() const {
+            return {_executed.load(std::memory_order_relaxed), _stolen.load(std::memory_order_relaxed)};
+        }
+
+      private:
+        struct task { // move-only, unlike std::function
+            struct base {
+                virtual ~base() = default;
+                virtual void run() = 0;
+            };
+            template <typename F> struct impl : base {
+                explicit impl(F&& f) : f(std::move(f)) {}
+                void run() override { f(); }
+                F f;
+            };
+            std::unique_ptr<base> p;
+        };
+
+        struct worker {
+            std::mutex       mx;
+            std::deque<task> q;
+        };
+
+        static inline thread_local pool*  t_pool  = nullptr;
+        static inline thread_local size_t t_index = 0;
+
+        bool running_in_this_thread() const { return t_pool == this; }
+
+        template <typename F> void push(F&& f) {
+            task t{std::make_unique<task::impl<std::decay_t<F>>>(std::forward<F>(f))};
+            size_t i = running_in_this_thread() ? t_index : _next.fetch_add(1, std::memory_order_relaxed) % size();
+            {
+                std::lock_guard<std::mutex> lk(_workers[i]->mx);
+                _workers[i]->q.push_back(std::move(t));
+            }
+            _queued.fetch_add(1); // seq_cst: pairs with the sleeper's _sleeping/_queued
+            if (_sleeping.load()) {
+                std::lock_guard<std::mutex> lk(_idle_mx); // no lost wakeup
+                _idle_cv.notify_one();
+            }
+        }
+
+        bool pop(size_t self, task& out) { // own deque first, then steal
+            for (size_t k = 0; k < size(); ++k) {
+                size_t i = (self + k) % size();
+                auto&  w = *_workers[i];
+                std::lock_guard<std::mutex> lk(w.mx);
+                if (w.q.empty())
+                    continue;
+                if (k == 0) {
+                    out = std::move(w.q.back());
+                    w.q.pop_back();
+                } else {
+                    out = std::move(w.q.front());
+                    w.q.pop_front();
+                    _stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+                _queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void run(size_t self) {
+            t_pool  = this;
+            t_index = self;
+            for (task t;;) {
+                if (pop(self, t)) {
+                    t.p->run();
+                    t.p.reset();
+                    _executed.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lk(_idle_mx);
+                _sleeping.fetch_add(1);
+                _idle_cv.wait(lk, [this] { return _stopped || _queued.load(); });
+                _sleeping.fetch_sub(1);
+                if (_stopped)
+                    return;
+            }
+        }
+
+        std::vector<std::unique_ptr<worker>> _workers;
+        std::vector<std::thread>             _threads;
+        std::atomic<size_t>                  _next{0}, _queued{0}, _sleeping{0};
+        std::atomic<size_t>                  _executed{0}, _stolen{0};
+        std::mutex                           _idle_mx;
+        std::condition_variable              _idle_cv;
+        bool                                 _stopped = false;
+    };
+
+    // the (TS-style) executor requirements, so that ba::strand<> and
+    // ba::executor accept it
+    struct pool::executor_type {
+        explicit executor_type(pool& p) noexcept : _pool(&p) {}
+
+        pool& context() const noexcept { return *_pool; }
+        void  on_work_started() const noexcept {}
+        void  on_work_finished() const noexcept {} // the pool runs until stopped
+
+        template <typename F, typename A> void dispatch(F&& f, A const&) const {
+            if (_pool->running_in_this_thread()) {
+                std::decay_t<F> tmp(std::forward<F>(f));
+                tmp();
+            } else {
+                _pool->push(std::forward<F>(f));
+            }
+        }
+        template <typename F, typename A> void post(F&& f, A const&) const { _pool->push(std::forward<F>(f)); }
+        template <typename F, typename A> void defer(F&& f, A const&) const { _pool->push(std::forward<F>(f)); }
+
+        bool running_in_this_thread() const noexcept { return _pool->running_in_this_thread(); }
+
+        friend bool operator==(executor_type const& a, executor_type const& b) noexcept { return a._pool == b._pool; }
+        friend bool operator!=(executor_type const& a, executor_type const& b) noexcept { return a._pool != b._pool; }
+
+      private:
+        pool* _pool;
+    };
+
+    inline pool::executor_type pool::get_executor() noexcept { return executor_type(*this); }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <time.h> // for linux/errqueue.h
+#include <linux/errqueue.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+// MSG_ZEROCOPY sends (Linux >= 4.14, TCP).
+//
+// The kernel transmits straight from our pages and tells us on the socket's
+// error queue when it no longer needs them. Every successful zerocopy send
+// call gets the next 32-bit id; a notification acknowledges a range of ids.
+// The tracker holds a reference to each payload until its id is acknowledged.
+//
+// The setup and the notifications cost more than copying small payloads, and
+// on loopback the kernel copies anyway (reported as `copied`). Measure with
+// bench_zerocopy before picking a threshold.
+namespace zerocopy {
+    using payload = std::shared_ptr<std::string const>;
+
+    inline bool enable(int fd) {
+        int one = 1;
+        return ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
+
+    struct tracker {
+        void sent(payload p) { _pending.push_back({_next_id++, std::move(p)}); }
+        bool idle() const { return _pending.empty(); }
+        size_t pending() const { return _pending.size(); }
+
+        size_t completed = 0; // sends acknowledged
+        size_t copied    = 0; // ... of which the kernel fell back to copying
+
+        // drains the error queue without blocking; returns notifications seen
+        size_t reap(int fd) {
+            size_t n = 0;
+            for (;; ++n) {
+                alignas(cmsghdr) char control[128];
+                msghdr msg{};
+                msg.msg_control    = control;
+                msg.msg_controllen = sizeof(control);
+
+                if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+                    return n; // EAGAIN: drained
+
+                for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                    auto err = reinterpret_cast<sock_extended_err const*>(CMSG_DATA(cm));
+                    if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                        continue;
+                    release(err->ee_info, err->ee_data, err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+                }
+            }
+        }
+
+      private:
+        void release(uint32_t lo, uint32_t hi, bool was_copied) { // ids [lo, hi], TCP acks in order
+            while (!_pending.empty() && uint32_t(_pending.front().id - lo) <= uint32_t(hi - lo)) {
+                _pending.pop_front();
+                ++completed;
+                copied += was_copied;
+            }
+        }
+
+        struct entry {
+            uint32_t id;
+            payload  keep;
+        };
+
+        uint32_t          _next_id = 0;
+        std::deque<entry> _pending;
+    };
+}